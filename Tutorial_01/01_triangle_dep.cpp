@@ -23,6 +23,17 @@ void renderGL(void)
 
 int main(int argc, char** argv)
 {
+  //! Render offscreen without a window when asked to (--headless or CSX75_HEADLESS=1)
+  if (csX75::parse_headless_args(argc, argv))
+    {
+      if (!csX75::initHeadlessGL(640, 480))
+	return -1;
+      csX75::initGL();
+      csX75::runHeadlessGL(renderGL);
+      csX75::terminateHeadlessGL();
+      return 0;
+    }
+
   //! The pointer to the GLFW window
   GLFWwindow* window;
 
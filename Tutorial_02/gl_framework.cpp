@@ -1,5 +1,12 @@
 #include "gl_framework.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
 namespace csX75
 {
   //! Initialize GL State
@@ -35,6 +42,160 @@ namespace csX75
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
       glfwSetWindowShouldClose(window, GL_TRUE);
   }
+
+  //! Offscreen rendering state, used when there is no display to open a window on
+  static EGLDisplay headless_display = EGL_NO_DISPLAY;
+  static EGLContext headless_context = EGL_NO_CONTEXT;
+  static GLuint headless_fbo = 0;
+  static GLuint headless_rbo[2];
+  static int headless_width = 0, headless_height = 0;
+  static int headless_frames = 1;
+
+  bool parse_headless_args(int &argc, char** argv)
+  {
+    bool headless = false;
+
+    //!The environment lets a batch script switch every binary over at once
+    const char* env = getenv("CSX75_HEADLESS");
+    if (env != NULL && *env != '\0' && strcmp(env, "0") != 0)
+      headless = true;
+    env = getenv("CSX75_FRAMES");
+    if (env != NULL)
+      headless_frames = atoi(env);
+
+    //!Remove our flags so that the tutorial still sees its own arguments at argv[1]
+    int out = 1;
+    for (int i = 1; i < argc; i++)
+      {
+	if (strcmp(argv[i], "--headless") == 0)
+	  headless = true;
+	else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+	  headless_frames = atoi(argv[++i]);
+	else
+	  argv[out++] = argv[i];
+      }
+    argc = out;
+
+    if (headless_frames < 1)
+      headless_frames = 1;
+    return headless;
+  }
+
+  bool initHeadlessGL(int width, int height)
+  {
+    //!Prefer the Mesa surfaceless platform, it needs neither X11 nor a DRM master
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL)
+      headless_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (headless_display == EGL_NO_DISPLAY)
+      headless_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (headless_display == EGL_NO_DISPLAY || !eglInitialize(headless_display, &major, &minor))
+      {
+	std::cerr<<"EGL Init Failed"<<std::endl;
+	return false;
+      }
+
+    const EGLint config_attribs[] = {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE
+    };
+    EGLConfig config;
+    EGLint num_configs = 0;
+    eglChooseConfig(headless_display, config_attribs, &config, 1, &num_configs);
+
+    //!Same context that the GLFW window asks for - OpenGL 3.3 core
+    const EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION, 3,
+      EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE
+    };
+    eglBindAPI(EGL_OPENGL_API);
+    headless_context = eglCreateContext(headless_display, num_configs > 0 ? config : NULL,
+					EGL_NO_CONTEXT, context_attribs);
+    if (headless_context == EGL_NO_CONTEXT ||
+	!eglMakeCurrent(headless_display, EGL_NO_SURFACE, EGL_NO_SURFACE, headless_context))
+      {
+	std::cerr<<"EGL Context Creation Failed : "<<std::hex<<eglGetError()<<std::dec<<std::endl;
+	eglTerminate(headless_display);
+	return false;
+      }
+
+    //Turn this on to get Shader based OpenGL
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    if (GLEW_OK != err)
+      {
+	//A GLX-only GLEW reports a missing X display here, the GL entry points are loaded regardless
+	std::cerr<<"GLEW Init Failed : "<<glewGetErrorString(err)<<std::endl;
+      }
+
+    //!There is no default framebuffer, so draw into a colour and depth renderbuffer pair
+    headless_width = width;
+    headless_height = height;
+    glGenFramebuffers(1, &headless_fbo);
+    glGenRenderbuffers(2, headless_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless_rbo[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless_rbo[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, headless_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless_rbo[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headless_rbo[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      {
+	std::cerr<<"Offscreen framebuffer is incomplete"<<std::endl;
+	terminateHeadlessGL();
+	return false;
+      }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, width, height);
+
+    std::cout<<"Headless Renderer: "<<glGetString (GL_RENDERER)<<std::endl;
+    return true;
+  }
+
+  void runHeadlessGL(void (*render)(void))
+  {
+    //!No swap, no vsync - frames are only limited by how fast the GL can draw them
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < headless_frames; i++)
+      render();
+    glFinish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout<<"Rendered "<<headless_frames<<" frames in "<<seconds<<" s ("
+	     <<headless_frames / seconds<<" fps)"<<std::endl;
+  }
+
+  void terminateHeadlessGL(void)
+  {
+    if (headless_fbo != 0)
+      {
+	glDeleteFramebuffers(1, &headless_fbo);
+	glDeleteRenderbuffers(2, headless_rbo);
+	headless_fbo = 0;
+      }
+    if (headless_display != EGL_NO_DISPLAY)
+      {
+	eglMakeCurrent(headless_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (headless_context != EGL_NO_CONTEXT)
+	  eglDestroyContext(headless_display, headless_context);
+	eglTerminate(headless_display);
+      }
+    headless_context = EGL_NO_CONTEXT;
+    headless_display = EGL_NO_DISPLAY;
+  }
+
+  void get_headless_size(int* width, int* height)
+  {
+    *width = headless_width;
+    *height = headless_height;
+  }
 };  
   
 
@@ -1,8 +1,28 @@
 #include <GL/glew.h>
 #include "shader_util.hpp"
 
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+
 namespace csX75
 {
+  //!What CreateShaderGL was given, so CreateProgramGL can look the program up in the cache
+  struct ShaderSource
+  {
+    GLenum type;
+    std::string source;
+    bool compiled;
+  };
+  static std::map<GLuint, ShaderSource> shader_sources;
+  //!Programs may be built on more than one thread (see shader_reload.cpp in Tutorial 5)
+  static std::mutex shader_sources_mutex;
+
   GLuint LoadShaderGL(GLenum eShaderType, const std::string &strFilename)
   {
     std::ifstream shaderFile(strFilename.c_str());
@@ -30,8 +50,19 @@ namespace csX75
     const char *strFileData = strShaderFile.c_str();
     glShaderSource(shader, 1, &strFileData, NULL);
     
-    glCompileShader(shader);
+    //!Compiling waits for CreateProgramGL, which skips it when the program is cached
+    std::lock_guard<std::mutex> lock(shader_sources_mutex);
+    ShaderSource &entry = shader_sources[shader];
+    entry.type = eShaderType;
+    entry.source = strShaderFile;
+    entry.compiled = false;
     
+    return shader;
+  }
+
+  //!Print the log of a shader that did not compile. Asking for the status waits for the compile.
+  static void check_compile_status(GLuint shader, GLenum eShaderType)
+  {
     GLint status;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
     if (status == GL_FALSE)
@@ -53,19 +84,213 @@ namespace csX75
 	std::cerr<<"Compile failure in "<<strShaderType<<" shader:"<<std::endl<<strInfoLog<<std::endl;
 	delete[] strInfoLog;
       }
-    
-    return shader;
   }
   
-  GLuint CreateProgramGL(const std::vector<GLuint> &shaderList)
+  //!Cache directory from CSX75_SHADER_CACHE (empty turns the cache off), NULL if there is none
+  static const char* cache_directory(void)
   {
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+      return NULL;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0)
+      return NULL;
+
+    const char* dir = getenv("CSX75_SHADER_CACHE");
+    if (dir == NULL)
+      dir = ".shader_cache";
+    if (*dir == '\0')
+      return NULL;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+      return NULL;
+    return dir;
+  }
+
+  //!FNV-1a over the driver and every shader, so a new driver or an edited shader misses
+  static unsigned long long cache_key(const std::vector<GLuint> &shaderList, bool &known)
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    std::string key;
+    const GLenum strings[4] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    for (int i = 0; i < 4; i++)
+      {
+	const GLubyte* s = glGetString(strings[i]);
+	key += s != NULL ? (const char*) s : "";
+	key += '\n';
+      }
+
+    known = true;
+    std::lock_guard<std::mutex> lock(shader_sources_mutex);
+    for (size_t iLoop = 0; iLoop < shaderList.size(); iLoop++)
+      {
+	std::map<GLuint, ShaderSource>::const_iterator entry = shader_sources.find(shaderList[iLoop]);
+	if (entry == shader_sources.end())
+	  {
+	    known = false;
+	    break;
+	  }
+	char type[16];
+	snprintf(type, sizeof(type), "%x\n", entry->second.type);
+	key += type;
+	key += entry->second.source;
+	key += '\0';
+      }
+
+    for (size_t i = 0; i < key.size(); i++)
+      {
+	hash ^= (unsigned char) key[i];
+	hash *= 1099511628211ULL;
+      }
+    return hash;
+  }
+
+  static const char cache_magic[8] = { 'c', 's', 'X', '7', '5', 'P', 'B', '1' };
+
+  //!The cached binary in a new program, 0 if there is none or the driver refuses it
+  static GLuint load_cached_program(const std::string &path, unsigned long long key)
+  {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+      return 0;
+
+    char magic[8];
+    unsigned long long file_key;
+    GLenum format;
+    GLint length;
+    std::vector<char> binary;
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, cache_magic, sizeof(magic)) == 0 &&
+      fread(&file_key, sizeof(file_key), 1, file) == 1 && file_key == key &&
+      fread(&format, sizeof(format), 1, file) == 1 &&
+      fread(&length, sizeof(length), 1, file) == 1 && length > 0;
+    if (ok)
+      {
+	binary.resize(length);
+	ok = fread(binary.data(), 1, length, file) == (size_t) length;
+      }
+    fclose(file);
+    if (!ok)
+      return 0;
+
     GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), length);
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE)
+      {
+	//!Stale - usually a driver update the version strings did not show
+	glDeleteProgram(program);
+	remove(path.c_str());
+	return 0;
+      }
+    return program;
+  }
+
+  static void save_cached_program(const std::string &path, unsigned long long key, GLuint program)
+  {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+      return;
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    //!Written aside and renamed, so a second instance never reads half a file
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (file == NULL)
+      return;
+    bool ok = fwrite(cache_magic, sizeof(cache_magic), 1, file) == 1 &&
+      fwrite(&key, sizeof(key), 1, file) == 1 &&
+      fwrite(&format, sizeof(format), 1, file) == 1 &&
+      fwrite(&length, sizeof(length), 1, file) == 1 &&
+      fwrite(binary.data(), 1, length, file) == (size_t) length;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0)
+      remove(temp.c_str());
+  }
+
+  //!A program between issuing its compile and link and checking how they went
+  struct PendingProgram
+  {
+    GLuint program;
+    std::vector<GLuint> shaders;
+    std::vector<GLenum> types;   // of the shaders compiled for it
+    std::string cache_path;
+    unsigned long long cache_key;
+    bool cacheable, cached, done;
+  };
+
+  //!Load the program from the cache, or start compiling and linking it without waiting
+  static void begin_program(const std::vector<GLuint> &shaderList, const char* dir, PendingProgram &pending)
+  {
+    pending.shaders = shaderList;
+    pending.cacheable = false;
+    pending.cached = false;
+    pending.done = false;
+    if (dir != NULL)
+      {
+	pending.cache_key = cache_key(shaderList, pending.cacheable);
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.bin", pending.cache_key);
+	pending.cache_path = std::string(dir) + name;
+      }
+    if (pending.cacheable)
+      {
+	pending.program = load_cached_program(pending.cache_path, pending.cache_key);
+	if (pending.program != 0)
+	  {
+	    pending.cached = true;
+	    return;
+	  }
+      }
+
+    std::vector<GLuint> compiled;
+    for(size_t iLoop = 0; iLoop < shaderList.size(); iLoop++)
+      {
+	GLenum type = GL_NONE;
+	{
+	  std::lock_guard<std::mutex> lock(shader_sources_mutex);
+	  std::map<GLuint, ShaderSource>::iterator entry = shader_sources.find(shaderList[iLoop]);
+	  if (entry != shader_sources.end() && !entry->second.compiled)
+	    {
+	      type = entry->second.type;
+	      entry->second.compiled = true;
+	    }
+	}
+	if (type != GL_NONE)
+	  {
+	    glCompileShader(shaderList[iLoop]);
+	    compiled.push_back(shaderList[iLoop]);
+	    pending.types.push_back(type);
+	  }
+      }
+    pending.shaders.swap(compiled);
+
+    pending.program = glCreateProgram();
+    if (pending.cacheable)
+      glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     
     for(size_t iLoop = 0; iLoop < shaderList.size(); iLoop++)
-      glAttachShader(program, shaderList[iLoop]);
+      glAttachShader(pending.program, shaderList[iLoop]);
     
-    glLinkProgram(program);
+    glLinkProgram(pending.program);
     
+    for(size_t iLoop = 0; iLoop < shaderList.size(); iLoop++)
+      glDetachShader(pending.program, shaderList[iLoop]);
+  }
+
+  //!Report compile and link errors, and put a good program in the cache
+  static void finish_program(PendingProgram &pending)
+  {
+    pending.done = true;
+    if (pending.cached)
+      return;
+
+    for(size_t iLoop = 0; iLoop < pending.shaders.size(); iLoop++)
+      check_compile_status(pending.shaders[iLoop], pending.types[iLoop]);
+
+    GLuint program = pending.program;
     GLint status;
     glGetProgramiv (program, GL_LINK_STATUS, &status);
     if (status == GL_FALSE)
@@ -78,11 +303,62 @@ namespace csX75
 	std::cerr<<"GLSL Linker failure: "<<strInfoLog<<std::endl;
 	delete[] strInfoLog;
       }
+    else if (pending.cacheable)
+      save_cached_program(pending.cache_path, pending.cache_key, program);
+  }
     
-    for(size_t iLoop = 0; iLoop < shaderList.size(); iLoop++)
-      glDetachShader(program, shaderList[iLoop]);
+  std::vector<GLuint> CreateProgramsGL(const std::vector< std::vector<GLuint> > &shaderLists)
+  {
+    //!With KHR_parallel_shader_compile the driver compiles on threads of its own,
+    //!as many as it likes, and GL_COMPLETION_STATUS_KHR says when each one is done
+    static bool threads_set = false;
+    bool parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    if (parallel && !threads_set)
+      {
+	if (GLEW_KHR_parallel_shader_compile)
+	  glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else
+	  glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	threads_set = true;
+      }
     
-    return program;
+    //!Issue every compile and link first - a status query would wait for that one program
+    const char* dir = cache_directory();
+    std::vector<PendingProgram> pending(shaderLists.size());
+    for (size_t i = 0; i < shaderLists.size(); i++)
+      begin_program(shaderLists[i], dir, pending[i]);
+
+    //!Then check them in the order they finish
+    size_t left = pending.size();
+    while (left > 0)
+      {
+	for (size_t i = 0; i < pending.size(); i++)
+	  {
+	    if (pending[i].done)
+	      continue;
+	    if (parallel && !pending[i].cached)
+	      {
+		GLint complete = GL_TRUE;
+		glGetProgramiv(pending[i].program, GL_COMPLETION_STATUS_KHR, &complete);
+		if (complete == GL_FALSE)
+		  continue;
+	      }
+	    finish_program(pending[i]);
+	    left--;
+	  }
+	if (left > 0)
+	  std::this_thread::yield();
+      }
+
+    std::vector<GLuint> programs(pending.size());
+    for (size_t i = 0; i < pending.size(); i++)
+      programs[i] = pending[i].program;
+    return programs;
+  }
+
+  GLuint CreateProgramGL(const std::vector<GLuint> &shaderList)
+  {
+    return CreateProgramsGL(std::vector< std::vector<GLuint> >(1, shaderList))[0];
   }
 
 };
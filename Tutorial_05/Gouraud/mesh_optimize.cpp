@@ -0,0 +1,174 @@
+#include "mesh_optimize.hpp"
+
+#include <cmath>
+
+namespace csX75
+{
+  //!FIFO cache simulation: a vertex is still cached while fewer than cache_size
+  //!others have gone in after it
+  VertexCacheStats AnalyzeVertexCache(const std::vector<GLuint> &indices, std::size_t vertex_count,
+				      unsigned int cache_size)
+  {
+    std::vector<unsigned int> stamp(vertex_count, 0);
+    std::vector<bool> used(vertex_count, false);
+    unsigned int time = cache_size + 1;
+    std::size_t unique = 0;
+
+    VertexCacheStats stats;
+    stats.transforms = 0;
+    for (std::size_t i = 0; i < indices.size(); i++)
+      {
+	GLuint v = indices[i];
+	if (time - stamp[v] > cache_size)
+	  {
+	    stamp[v] = time++;
+	    stats.transforms++;
+	  }
+	if (!used[v])
+	  {
+	    used[v] = true;
+	    unique++;
+	  }
+      }
+    stats.acmr = indices.empty() ? 0.0f : (float) stats.transforms / (indices.size() / 3);
+    stats.atvr = unique == 0 ? 0.0f : (float) stats.transforms / unique;
+    return stats;
+  }
+
+  //!The size of cache the scores aim at. Larger than the 16 to 32 entries of
+  //!hardware caches, which still do better with it than with 32 here, and
+  //!llvmpipe, which shades up to 1023 indices at a time through a 256 slot
+  //!cache, does much better
+  static const int kCacheSize = 64;
+
+  //!Recently used vertices score high, the last triangle's three a little
+  //!less so the next one does not just turn back on itself. Vertices with few
+  //!triangles left score high too, so no lone triangles get stranded.
+  static float vertex_score(int cache_position, unsigned int remaining)
+  {
+    if (remaining == 0)
+      return -1.0f;
+    float score = 0.0f;
+    if (cache_position >= 0)
+      {
+	if (cache_position < 3)
+	  score = 0.75f;
+	else
+	  score = powf(1.0f - (float) (cache_position - 3) / (kCacheSize - 3), 1.5f);
+      }
+    return score + 2.0f / sqrtf((float) remaining);
+  }
+
+  void OptimizeVertexCache(std::vector<GLuint> &indices, std::size_t vertex_count)
+  {
+    std::size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+      return;
+
+    //!The triangles around each vertex, remaining[v] of them still to emit,
+    //!kept at the front of the vertex's run in adjacency
+    std::vector<unsigned int> remaining(vertex_count, 0), offsets(vertex_count + 1, 0);
+    for (std::size_t i = 0; i < indices.size(); i++)
+      remaining[indices[i]]++;
+    for (std::size_t v = 0; v < vertex_count; v++)
+      offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size()), filled(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); i++)
+      adjacency[filled[indices[i]]++] = i / 3;
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> score(vertex_count);
+    for (std::size_t v = 0; v < vertex_count; v++)
+      score[v] = vertex_score(-1, remaining[v]);
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    int best = 0;
+    for (std::size_t t = 0; t < triangle_count; t++)
+      {
+	triangle_score[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+	if (triangle_score[t] > triangle_score[best])
+	  best = t;
+      }
+
+    std::vector<GLuint> ordered, cache, next_cache;
+    ordered.reserve(indices.size());
+    std::size_t next_unemitted = 0;
+    while (ordered.size() < indices.size())
+      {
+	//!Nothing in the cache has a triangle left, start again from the input order
+	if (best < 0)
+	  {
+	    while (emitted[next_unemitted])
+	      next_unemitted++;
+	    best = next_unemitted;
+	  }
+	emitted[best] = true;
+
+	next_cache.clear();
+	for (int k = 0; k < 3; k++)
+	  {
+	    GLuint v = indices[3 * best + k];
+	    ordered.push_back(v);
+	    next_cache.push_back(v);
+
+	    unsigned int* around = &adjacency[offsets[v]];
+	    for (unsigned int j = 0; j < remaining[v]; j++)
+	      if (around[j] == (unsigned int) best)
+		{
+		  around[j] = around[remaining[v] - 1];
+		  break;
+		}
+	    remaining[v]--;
+	  }
+	for (std::size_t i = 0; i < cache.size(); i++)
+	  if (cache[i] != next_cache[0] && cache[i] != next_cache[1] && cache[i] != next_cache[2])
+	    next_cache.push_back(cache[i]);
+	cache.swap(next_cache);
+
+	//!Rescore what is cached and what just fell out, then the triangles around them
+	for (std::size_t i = 0; i < cache.size(); i++)
+	  {
+	    GLuint v = cache[i];
+	    cache_position[v] = i < (std::size_t) kCacheSize ? (int) i : -1;
+	    score[v] = vertex_score(cache_position[v], remaining[v]);
+	  }
+	best = -1;
+	float best_score = 0.0f;
+	for (std::size_t i = 0; i < cache.size(); i++)
+	  {
+	    GLuint v = cache[i];
+	    for (unsigned int j = 0; j < remaining[v]; j++)
+	      {
+		unsigned int t = adjacency[offsets[v] + j];
+		triangle_score[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+		if (triangle_score[t] > best_score)
+		  {
+		    best_score = triangle_score[t];
+		    best = t;
+		  }
+	      }
+	  }
+	if (cache.size() > (std::size_t) kCacheSize)
+	  cache.resize(kCacheSize);
+      }
+    indices.swap(ordered);
+  }
+
+  std::vector<GLuint> OptimizeVertexFetch(std::vector<GLuint> &indices, std::size_t vertex_count)
+  {
+    const GLuint unused = (GLuint) -1;
+    std::vector<GLuint> remap(vertex_count, unused);
+    GLuint next = 0;
+    for (std::size_t i = 0; i < indices.size(); i++)
+      {
+	GLuint &v = remap[indices[i]];
+	if (v == unused)
+	  v = next++;
+	indices[i] = v;
+      }
+    for (std::size_t v = 0; v < vertex_count; v++)
+      if (remap[v] == unused)
+	remap[v] = next++;
+    return remap;
+  }
+};
@@ -13,8 +13,14 @@
 namespace csX75
 {
   GLuint LoadShaderGL(GLenum eShaderType, const std::string &strFilename);
+  //! The shader is compiled by CreateProgramGL, and only if the program is not in the cache
   GLuint CreateShaderGL(GLenum eShaderType, const std::string &strShaderFile);
+  //! Linked programs are kept as driver binaries in the directory CSX75_SHADER_CACHE
+  //! (.shader_cache by default, empty turns it off), keyed by the sources and the driver
   GLuint CreateProgramGL(const std::vector<GLuint> &shaderList);
+  //! Build several programs at once - every compile and link is issued before any
+  //! status is checked, so a driver with KHR_parallel_shader_compile works on all of them together
+  std::vector<GLuint> CreateProgramsGL(const std::vector< std::vector<GLuint> > &shaderLists);
 };
 
 #endif
@@ -0,0 +1,49 @@
+#ifndef _SPHERE_BUILDER_HPP_
+#define _SPHERE_BUILDER_HPP_
+
+#include "sphere_mesh.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace csX75
+{
+  //! Makes spheres on a thread of its own, so a change of tesselation does not
+  //! stall the render loop while the levels are generated and optimised.
+  //! request() returns at once. The render loop calls update() at the start
+  //! of a frame, which hands over the finished levels when there are some, to be
+  //! uploaded into buffers the GPU is not drawing from. Requests made while
+  //! a sphere is being built replace each other, only the latest is built.
+  class SphereBuilder
+  {
+  public:
+    SphereBuilder();
+    ~SphereBuilder();
+
+    //! Build MakeSphereLODs(radius, tesselation, icosphere)
+    void request(float radius, int tesselation, bool icosphere);
+    //! Swap a finished sphere into lods, returns true if there was one
+    bool update(SphereLODs &lods);
+
+  private:
+    void worker_loop(void);
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    //!The sphere asked for and not yet started, if wanted
+    bool wanted;
+    float radius;
+    int tesselation;
+    bool icosphere;
+
+    //!The last sphere finished, if built
+    bool built;
+    SphereLODs finished;
+  };
+};
+
+#endif
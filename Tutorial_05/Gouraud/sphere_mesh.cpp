@@ -0,0 +1,277 @@
+#include "sphere_mesh.hpp"
+#include "mesh_optimize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include "glm/geometric.hpp"
+
+namespace csX75
+{
+  void MakeUVSphere(float radius, int lats, int longs, IndexedMesh &mesh)
+  {
+    lats = std::max(lats, 2);
+    longs = std::max(longs, 3);
+    mesh.positions.clear();
+    mesh.normals.clear();
+    mesh.triangles.clear();
+
+    //!Every angle from its integer step, so nothing drifts however fine the mesh
+    const double pi = 3.14159265358979323846;
+    mesh.normals.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+    for (int i = 1; i < lats; i++)
+      {
+	double lat = pi * i / lats;
+	for (int j = 0; j < longs; j++)
+	  {
+	    double lng = 2.0 * pi * j / longs;
+	    mesh.normals.push_back(glm::vec3(sin(lat) * cos(lng), sin(lat) * sin(lng), cos(lat)));
+	  }
+      }
+    mesh.normals.push_back(glm::vec3(0.0f, 0.0f, -1.0f));
+    for (std::size_t v = 0; v < mesh.normals.size(); v++)
+      mesh.positions.push_back(radius * mesh.normals[v]);
+
+    //!Ring i (1 to lats - 1) starts at vertex 1 + (i - 1) * longs, and wraps around
+    GLuint south = (GLuint) mesh.positions.size() - 1;
+    for (int j = 0; j < longs; j++)
+      {
+	GLuint a = 1 + j, b = 1 + (j + 1) % longs;
+	mesh.triangles.push_back(0); mesh.triangles.push_back(a); mesh.triangles.push_back(b);
+      }
+    for (int i = 1; i < lats - 1; i++)
+      for (int j = 0; j < longs; j++)
+	{
+	  GLuint a = 1 + (i - 1) * longs + j, b = 1 + (i - 1) * longs + (j + 1) % longs;
+	  GLuint c = a + longs, d = b + longs;
+	  mesh.triangles.push_back(a); mesh.triangles.push_back(c); mesh.triangles.push_back(d);
+	  mesh.triangles.push_back(a); mesh.triangles.push_back(d); mesh.triangles.push_back(b);
+	}
+    for (int j = 0; j < longs; j++)
+      {
+	GLuint a = 1 + (lats - 2) * longs + j, b = 1 + (lats - 2) * longs + (j + 1) % longs;
+	mesh.triangles.push_back(a); mesh.triangles.push_back(south); mesh.triangles.push_back(b);
+      }
+    MakeWireframe(mesh);
+  }
+
+  //!The vertex halfway along an edge, pushed out to the unit sphere, made once per edge
+  static GLuint midpoint(GLuint a, GLuint b, std::vector<glm::vec3> &normals,
+			 std::unordered_map<unsigned long long, GLuint> &made)
+  {
+    unsigned long long key = ((unsigned long long) std::min(a, b) << 32) | std::max(a, b);
+    std::unordered_map<unsigned long long, GLuint>::const_iterator found = made.find(key);
+    if (found != made.end())
+      return found->second;
+    normals.push_back(glm::normalize(normals[a] + normals[b]));
+    GLuint index = (GLuint) normals.size() - 1;
+    made[key] = index;
+    return index;
+  }
+
+  void MakeIcosphere(float radius, int subdivisions, IndexedMesh &mesh)
+  {
+    //!The twelve corners of an icosahedron are the corners of three golden rectangles
+    const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+    const float corners[12][3] = {
+      { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+      { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+      { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+    };
+    const GLuint faces[20][3] = {
+      { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+      { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+      { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+      { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+    };
+
+    mesh.positions.clear();
+    mesh.normals.clear();
+    mesh.triangles.clear();
+    for (int v = 0; v < 12; v++)
+      mesh.normals.push_back(glm::normalize(glm::vec3(corners[v][0], corners[v][1], corners[v][2])));
+    for (int f = 0; f < 20; f++)
+      mesh.triangles.insert(mesh.triangles.end(), faces[f], faces[f] + 3);
+
+    for (int s = 0; s < subdivisions; s++)
+      {
+	std::unordered_map<unsigned long long, GLuint> made;
+	std::vector<GLuint> finer;
+	finer.reserve(mesh.triangles.size() * 4);
+	for (std::size_t i = 0; i < mesh.triangles.size(); i += 3)
+	  {
+	    GLuint a = mesh.triangles[i], b = mesh.triangles[i + 1], c = mesh.triangles[i + 2];
+	    GLuint ab = midpoint(a, b, mesh.normals, made);
+	    GLuint bc = midpoint(b, c, mesh.normals, made);
+	    GLuint ca = midpoint(c, a, mesh.normals, made);
+	    GLuint split[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+	    finer.insert(finer.end(), split, split + 12);
+	  }
+	mesh.triangles.swap(finer);
+      }
+
+    for (std::size_t v = 0; v < mesh.normals.size(); v++)
+      mesh.positions.push_back(radius * mesh.normals[v]);
+    MakeWireframe(mesh);
+  }
+
+  //!Rings are as far apart as the tesselation always made them, 9/tesselation radians
+  static int sphere_lats(int tesselation)
+  {
+    return std::max(2, (int) ceil(3.14159265358979323846 * tesselation / 9.0));
+  }
+
+  //!About as many triangles as the UV sphere, but all of the same size
+  static int icosphere_subdivisions(int tesselation)
+  {
+    double triangles = 4.0 * sphere_lats(tesselation) * (sphere_lats(tesselation) - 1);
+    return std::max(0, (int) floor(log(triangles / 20.0) / log(4.0) + 0.5));
+  }
+
+  void MakeSphere(float radius, int tesselation, bool icosphere, IndexedMesh &mesh)
+  {
+    if (icosphere)
+      MakeIcosphere(radius, icosphere_subdivisions(tesselation), mesh);
+    else
+      MakeUVSphere(radius, sphere_lats(tesselation), 2 * sphere_lats(tesselation), mesh);
+  }
+
+  //!Hashes the bits of a position, with -0 made +0 first so that equal
+  //!positions hash the same
+  struct PositionHash
+  {
+    std::size_t operator()(const glm::vec3 &p) const
+    {
+      float xyz[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+      unsigned int bits[3];
+      memcpy(bits, xyz, sizeof(bits));
+      return (std::size_t) bits[0] * 73856093u ^ (std::size_t) bits[1] * 19349663u ^ (std::size_t) bits[2] * 83492791u;
+    }
+  };
+
+  void MakeSphereLODs(float radius, int tesselation, bool icosphere, SphereLODs &lods)
+  {
+    lods = SphereLODs();
+    int lats = sphere_lats(tesselation), subdivisions = icosphere_subdivisions(tesselation);
+
+    //!Both kinds of sphere make every angle from its integer step, so a vertex
+    //!a coarser level shares with a finer one is at exactly the same place
+    std::unordered_map<glm::vec3, GLuint, PositionHash> shared;
+    for (int level = 0; ; level++)
+      {
+	IndexedMesh coarser;
+	if (icosphere)
+	  {
+	    if (subdivisions - level < 0)
+	      break;
+	    MakeIcosphere(radius, subdivisions - level, coarser);
+	    //!The icosahedron's edges span 63.4 degrees, each subdivision halves them
+	    lods.edge_angle.push_back(1.1071487f / (1 << (subdivisions - level)));
+	  }
+	else
+	  {
+	    int level_lats = lats >> level;
+	    if (level_lats < 2 || (level > 0 && level_lats == lats >> (level - 1)))
+	      break;
+	    MakeUVSphere(radius, level_lats, 2 * level_lats, coarser);
+	    lods.edge_angle.push_back(3.14159265358979323846 / level_lats);
+	  }
+	OptimizeIndexedMesh(coarser);
+
+	std::vector<GLuint> remap(coarser.positions.size());
+	for (std::size_t v = 0; v < coarser.positions.size(); v++)
+	  {
+	    std::pair<std::unordered_map<glm::vec3, GLuint, PositionHash>::iterator, bool> added =
+	      shared.insert(std::make_pair(coarser.positions[v], (GLuint) lods.mesh.positions.size()));
+	    if (added.second)
+	      {
+		lods.mesh.positions.push_back(coarser.positions[v]);
+		lods.mesh.normals.push_back(coarser.normals[v]);
+	      }
+	    remap[v] = added.first->second;
+	  }
+
+	lods.first.push_back(lods.mesh.triangles.size());
+	lods.count.push_back(coarser.triangles.size());
+	for (std::size_t i = 0; i < coarser.triangles.size(); i++)
+	  lods.mesh.triangles.push_back(remap[coarser.triangles[i]]);
+	lods.line_first.push_back(lods.mesh.lines.size());
+	lods.line_count.push_back(coarser.lines.size());
+	for (std::size_t i = 0; i < coarser.lines.size(); i++)
+	  lods.mesh.lines.push_back(remap[coarser.lines[i]]);
+      }
+
+    std::vector<GLuint> remap = OptimizeVertexFetch(lods.mesh.triangles, lods.mesh.positions.size());
+    for (std::size_t i = 0; i < lods.mesh.lines.size(); i++)
+      lods.mesh.lines[i] = remap[lods.mesh.lines[i]];
+    RemapVertices(lods.mesh.positions, remap);
+    RemapVertices(lods.mesh.normals, remap);
+  }
+
+  //!How far, in pixels, the middle of an edge of a level lies inside the sphere
+  static float lod_error(const SphereLODs &lods, int level, float radius_px)
+  {
+    return radius_px * (1.0f - cosf(lods.edge_angle[level] / 2.0f));
+  }
+
+  int SelectSphereLOD(const SphereLODs &lods, float radius_px, float max_error_px, int current)
+  {
+    int levels = lods.edge_angle.size();
+    if (current < 0 || current >= levels)
+      current = levels - 1;
+
+    int level = current;
+    while (level > 0 && lod_error(lods, level, radius_px) > max_error_px)
+      level--;
+    //!Coarser only with a quarter of the error to spare, so it takes a third
+    //!larger a sphere to go back
+    if (level == current)
+      while (level + 1 < levels && lod_error(lods, level + 1, radius_px) <= 0.75f * max_error_px)
+	level++;
+    return level;
+  }
+
+  void MakeWireframe(IndexedMesh &mesh)
+  {
+    //!Triangles sharing an edge list it in opposite directions, keep it once
+    std::unordered_map<unsigned long long, bool> seen;
+    mesh.lines.clear();
+    for (std::size_t i = 0; i < mesh.triangles.size(); i += 3)
+      for (int e = 0; e < 3; e++)
+	{
+	  GLuint a = mesh.triangles[i + e], b = mesh.triangles[i + (e + 1) % 3];
+	  unsigned long long key = ((unsigned long long) std::min(a, b) << 32) | std::max(a, b);
+	  if (seen.insert(std::make_pair(key, true)).second)
+	    {
+	      mesh.lines.push_back(a);
+	      mesh.lines.push_back(b);
+	    }
+	}
+  }
+
+  void OptimizeIndexedMesh(IndexedMesh &mesh)
+  {
+    OptimizeVertexCache(mesh.triangles, mesh.positions.size());
+    std::vector<GLuint> remap = OptimizeVertexFetch(mesh.triangles, mesh.positions.size());
+    RemapVertices(mesh.positions, remap);
+    RemapVertices(mesh.normals, remap);
+    MakeWireframe(mesh);
+  }
+
+  GLenum UploadIndicesGL(const std::vector<GLuint> &indices, GLenum usage)
+  {
+    GLuint largest = 0;
+    for (std::size_t i = 0; i < indices.size(); i++)
+      largest = std::max(largest, indices[i]);
+
+    if (largest > 0xffff)
+      {
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), usage);
+	return GL_UNSIGNED_INT;
+      }
+    std::vector<GLushort> narrow(indices.begin(), indices.end());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, narrow.size() * sizeof(GLushort), narrow.data(), usage);
+    return GL_UNSIGNED_SHORT;
+  }
+};
@@ -0,0 +1,71 @@
+#ifndef _SPHERE_MESH_HPP_
+#define _SPHERE_MESH_HPP_
+
+#include <GL/glew.h>
+
+#include <vector>
+#include "glm/vec3.hpp"
+
+namespace csX75
+{
+  //! An indexed triangle mesh: every vertex is stored once, and triangles
+  //! refer to their corners by index. The wireframe is the edges of the
+  //! triangles, each once, as pairs of indices for GL_LINES.
+  struct IndexedMesh
+  {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<GLuint> triangles;
+    std::vector<GLuint> lines;
+  };
+
+  //! Rings of latitude from pole to pole about the z axis, and meridians
+  //! around it. lats rings (at least 2) and longs meridians (at least 3) give
+  //! 2 + (lats - 1) * longs vertices and 2 * longs * (lats - 1) triangles.
+  void MakeUVSphere(float radius, int lats, int longs, IndexedMesh &mesh);
+  //! An icosahedron with every triangle split in four, subdivisions times,
+  //! and pushed out to the sphere. 20 * 4^subdivisions evenly sized triangles.
+  void MakeIcosphere(float radius, int subdivisions, IndexedMesh &mesh);
+  //! The sphere of the tutorial's <amount_of_tesselation>: a UV sphere with
+  //! rings 9 / tesselation radians apart and twice as many meridians, or an
+  //! icosphere of about as many triangles.
+  void MakeSphere(float radius, int tesselation, bool icosphere, IndexedMesh &mesh);
+  //! Fill mesh.lines with each edge of mesh.triangles once
+  void MakeWireframe(IndexedMesh &mesh);
+  //! Order the triangles for the vertex cache, and the vertices in the order
+  //! the triangles use them, with the passes in mesh_optimize.hpp. The
+  //! wireframe is made again from the new order.
+  void OptimizeIndexedMesh(IndexedMesh &mesh);
+
+  //! One sphere at several tesselations. Level 0 is MakeSphere's sphere, and
+  //! each level after it has half the rings and meridians, or one subdivision
+  //! less, down to the coarsest there is. Every level indexes the same
+  //! vertices: those of level 0, then those of coarser levels that are not
+  //! also in level 0. Their triangles and wireframes follow one another in
+  //! mesh.triangles and mesh.lines.
+  struct SphereLODs
+  {
+    IndexedMesh mesh;
+    //! Where each level's indices start in mesh.triangles and mesh.lines, and how many there are
+    std::vector<GLsizei> first, count, line_first, line_count;
+    //! The angle the longest edges of each level span, in radians
+    std::vector<float> edge_angle;
+  };
+  //! Make the levels of MakeSphere(radius, tesselation, icosphere), each one
+  //! optimised like OptimizeIndexedMesh, with the vertices in the order the
+  //! levels use them, finest first
+  void MakeSphereLODs(float radius, int tesselation, bool icosphere, SphereLODs &lods);
+  //! The level to draw a sphere radius_px pixels in radius on screen with: the
+  //! coarsest whose edges stray at most max_error_px pixels from the true
+  //! surface. current is the level drawn last time. It only goes coarser
+  //! once that is well inside max_error_px, so a sphere close to the
+  //! boundary does not switch back and forth every frame.
+  int SelectSphereLOD(const SphereLODs &lods, float radius_px, float max_error_px, int current);
+
+  //! Upload indices into the bound GL_ELEMENT_ARRAY_BUFFER as 16 bit values
+  //! when every index fits, 32 bit otherwise. Returns the type to draw with,
+  //! GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+  GLenum UploadIndicesGL(const std::vector<GLuint> &indices, GLenum usage);
+};
+
+#endif
@@ -4,7 +4,13 @@ in vec3 normal;
 in vec4 eye;
 in vec4 COLOR;
 
-uniform mat4 viewMatrix;
+layout(std140) uniform FrameUniforms
+{
+  mat4 viewMatrix;
+  mat4 projectionMatrix;
+  mat4 viewProjectionMatrix;
+  vec4 cameraPosition;
+};
 
 out vec4 frag_color;
 
@@ -19,7 +25,7 @@ void main ()
 
   // Defining Light 
   vec4 lightPos = vec4(1.0, 1.0, 1.0, 0.0);
-  vec3 lightDir = vec3(viewMatrix * lightPos);  // Transforms with camera
+  vec3 lightDir = vec3(viewProjectionMatrix * lightPos);  // Transforms with camera
   lightDir = normalize( vec3(lightDir));  
 
   //Diffuse
@@ -5,15 +5,27 @@
   and applies per-pixel shading to it.
 
   To run the code
-  ./05_shading <amount_of_tesselation>
+  ./05_shading <amount_of_tesselation> [--icosphere] [--stats]
 
-  as long as amount of tesselation is between(20 & 80)
+  the higher the tesselation the finer the sphere. --icosphere
+  builds it from even triangles rather than latitude and longitude.
+  --stats prints the size of the sphere and of each level of detail.
 
   Use the arrow keys and PgUp,PgDn,
   keys to make the sphere move.
   
   Use the keys W, A, S, D to move Camera.
 
+  T and Y make the sphere finer and coarser. The new one is built
+  in the background and drawn as soon as it is ready.
+
+  Z and X move the Camera nearer and further. The smaller the
+  sphere is on screen the fewer triangles it is drawn with,
+  pressing L toggles that.
+
+  Saving 05_vshader.glsl or 05_fshader.glsl while the program runs
+  rebuilds the shaders in the background and swaps them in.
+
   At starting the scene is in Perspective Mode, 
   pressing P toggles the Wireframe.
 
@@ -31,7 +43,7 @@ bool wireframe=false;
 
 double PI=3.14159265;
 GLuint shaderProgram;
-GLuint vbo[2], vao[2];
+csX75::ShaderReloader* shader_reloader = NULL;
 
 glm::mat4 rotation_matrix;
 glm::mat4 projection_matrix;
@@ -45,24 +57,39 @@ glm::mat4 view_matrix;
 glm::mat4 modelview_matrix;
 glm::mat3 normal_matrix;
 
-GLuint uModelViewMatrix;
-GLuint viewMatrix;
+GLuint uModelMatrix;
 GLuint normalMatrix;
+//Camera matrices shared by every program, uploaded once a frame
+GLuint frame_ubo;
+FrameUniforms frame_uniforms;
 //-----------------------------------------------------------------
 
-//6 faces, 2 triangles/face, 3 vertices/triangle
-const int num_vertices = 3600;
-
-int tri_idx=0;
-glm::vec4 v_positions[num_vertices];
-glm::vec4 v_colors[num_vertices];
-glm::vec4 v_normals[num_vertices];
-
-// Variables for wireframe
-int wire_idx=0;
-glm::vec4 w_positions[num_vertices];
-glm::vec4 w_colors[num_vertices];
-glm::vec4 w_normals[num_vertices];
+//The sphere at each level of detail: the vertices of all of them, each once,
+//and the index lists of the triangles and wireframe of one level after another
+csX75::SphereLODs sphere_lods;
+bool use_icosphere=false;
+//Draw the coarsest level whose edges stay within lod_tolerance pixels of the
+//true sphere, rather than always the finest
+bool enable_lod=true;
+float lod_tolerance=0.5;
+//Print the size of the sphere and its levels of detail once it is built
+bool show_stats=false;
+int lod_level=-1;
+GLuint vPosition, vNormal, vColor;
+
+//The buffers of one sphere: positions and normals in a VBO, and a VAO
+//and an index buffer for the triangles and one for the wireframe
+struct SphereBuffers
+{
+  GLuint vbo, ibo[2], vao[2];
+  GLenum index_type[2];
+};
+//Two of them, the one drawn from and the one a rebuilt sphere goes into
+SphereBuffers sphere_buffers[2];
+int front_buffers = 0;
+//Makes the sphere again, off the render loop, when the tesselation changes
+csX75::SphereBuilder* sphere_builder = NULL;
+int built_tesselation;
 
 glm::vec4 color(0.6, 0.6, 0.6, 1.0);
 glm::vec4 black(0.2, 0.2, 0.2, 1.0);
@@ -70,75 +97,97 @@ glm::vec4 white(1.0, 1.0, 1.0, 1.0);
 
 double Radius = 1;
 
-int prev_tess = 30; 
-int Lat = 10;
-int Long = 10;
+void sphere(double radius, int tess)
+{
+  //Each level's triangles in an order the vertex cache can reuse, vertices in the order they are drawn
+  csX75::MakeSphereLODs(radius, tess, use_icosphere, sphere_lods);
+}
 
-void sphere(double radius, int Lats, int Longs)
+//Copy sphere_lods into a set of buffers. The old contents are orphaned,
+//so even buffers the GPU is still reading do not make this wait
+void uploadSphereGL(SphereBuffers &buffers)
 {
-  float lats, longs;
+  //Copy the points into the vertex buffer, positions then normals
+  const csX75::IndexedMesh &mesh = sphere_lods.mesh;
+  std::size_t positions_size = mesh.positions.size() * sizeof(glm::vec3);
+  std::size_t normals_size = mesh.normals.size() * sizeof(glm::vec3);
+  glBindBuffer (GL_ARRAY_BUFFER, buffers.vbo);
+  glBufferData (GL_ARRAY_BUFFER, positions_size + normals_size, NULL, GL_STATIC_DRAW);
+  glBufferSubData( GL_ARRAY_BUFFER, 0, positions_size, mesh.positions.data() );
+  glBufferSubData( GL_ARRAY_BUFFER, positions_size, normals_size, mesh.normals.data() );
+
+  //The triangles for the sphere and the edges for the wireframe index the same vertices
+  const std::vector<GLuint>* indices[2] = { &mesh.triangles, &mesh.lines };
+  for (int i = 0; i < 2; i++)
+    {
+      glBindVertexArray (buffers.vao[i]);
+      glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, buffers.ibo[i]);
+      buffers.index_type[i] = csX75::UploadIndicesGL(*indices[i], GL_STATIC_DRAW);
 
-  // float slices=float(Lats)/100;
-  // float sectors=float(Longs)/100;
-  
-  float slices=(180/(float(Longs)*10))/2;
-  float sectors=(180/(float(Longs)*10))/2;
+      // set up vertex array, a missing w is 1
+      glEnableVertexAttribArray( vPosition );
+      glVertexAttribPointer( vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
 
-  float l;
+      glEnableVertexAttribArray( vNormal );
+      glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(positions_size) );
 
-  for (lats = 0.0; lats <= PI; lats+=sectors)  
+      //The colour is the same for every vertex, set with glVertexAttrib before drawing
+      glDisableVertexAttribArray( vColor );
+    }
+}
+
+//Ask for a new sphere when T or Y changed the tesselation, and draw it from
+//the other buffers once it is built. Called at the start of a frame
+void updateSphereGL(void)
+{
+  if (tesselation != built_tesselation)
     {
-      for(longs = 0.0; longs <= 2.0*PI; longs+=slices)
-	{
-	  float x = radius * sin(lats) * cos(longs);
-	  float y = radius * sin(lats) * sin(longs);
-	  float z = radius * cos(lats);
-	  glm::vec4 pt(x, y, z, 1.0);
-
-	  v_colors[tri_idx] = white; v_positions[tri_idx] = pt; 
-	  v_normals[tri_idx] = pt; tri_idx++;
-
-	  w_colors[wire_idx] = black; w_positions[wire_idx] = pt; 
-	  w_normals[wire_idx] = pt; wire_idx++;
-
-	  
-	  if(lats+sectors>PI)
-	    l=PI;
-	  else
-	    l=lats+sectors;
-	  x = radius * sin(l) * cos(longs);
-	  y = radius * sin(l) * sin(longs);
-	  z = radius * cos(l);
-	  pt =glm::vec4(x, y, z, 1.0);
-	  v_colors[tri_idx] = white; v_positions[tri_idx] = pt; 
-	  v_normals[tri_idx] = pt; tri_idx++;
-
-	  w_colors[wire_idx] = black; w_positions[wire_idx] = pt; 
-	  w_normals[wire_idx] = pt; wire_idx++;
-	  
-	}
+      sphere_builder->request(Radius, tesselation, use_icosphere);
+      built_tesselation = tesselation;
     }
+  if (sphere_builder->update(sphere_lods))
+    {
+      uploadSphereGL(sphere_buffers[1 - front_buffers]);
+      front_buffers = 1 - front_buffers;
+    }
+}
+
+//The level of detail to draw the sphere at, from how many pixels its radius
+//covers. Called once view_matrix and model_matrix are set for the frame
+int sphereLevel(void)
+{
+  //The centre in clip space, its w is how far in front of the camera it is
+  glm::vec4 centre = view_matrix*model_matrix*glm::vec4(0.0, 0.0, 0.0, 1.0);
+  if (!enable_lod || centre.w <= Radius)
+    lod_level = 0;
+  else
+    {
+      GLint viewport[4];
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      float radius_px = Radius * projection_matrix[1][1] / centre.w * viewport[3] / 2.0;
+      lod_level = csX75::SelectSphereLOD(sphere_lods, radius_px, lod_tolerance, lod_level);
+    }
+  return lod_level;
+}
 
-  // To Complete the wireframe
-   for (lats = 0.0; lats <= PI; lats+=sectors)  
-  {
-    for(longs = 0.0; longs <= 2.0*PI; longs+=slices)
-      {
-	float x = radius * sin(lats) * cos(longs);
-	float y = radius * sin(lats) * sin(longs);
-	float z = radius * cos(lats);
-	glm::vec4 pt(x, y, z, 1.0);
-	
-	w_colors[wire_idx] = black; w_positions[wire_idx] = pt; 
-	w_normals[wire_idx] = pt; wire_idx++;
-	
-      }
-  }
+//Draw count of the indices in the bound index buffer, starting at first
+void drawIndexRange(GLenum mode, GLsizei first, GLsizei count, GLenum index_type)
+{
+  std::size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+  glDrawElements(mode, count, index_type, BUFFER_OFFSET(first * index_size));
 }
 
 
 //-----------------------------------------------------------------
 
+//Uniform locations and the block binding have to be set up again for every newly linked program
+void getUniformsGL(void)
+{
+  uModelMatrix = glGetUniformLocation( shaderProgram, "uModelMatrix");
+  normalMatrix =  glGetUniformLocation( shaderProgram, "normalMatrix");
+  csX75::BindFrameUniformsGL( shaderProgram );
+}
+
 void initBuffersGL(void)
 {
 
@@ -154,73 +203,41 @@ void initBuffersGL(void)
   glUseProgram( shaderProgram );
 
   // getting the attributes from the shader program
-  GLuint vPosition = glGetAttribLocation( shaderProgram, "vPosition" );
-  GLuint vColor = glGetAttribLocation( shaderProgram, "vColor" ); 
-  GLuint vNormal = glGetAttribLocation( shaderProgram, "vNormal" ); 
-  uModelViewMatrix = glGetUniformLocation( shaderProgram, "uModelViewMatrix");
-  normalMatrix =  glGetUniformLocation( shaderProgram, "normalMatrix");
-  viewMatrix = glGetUniformLocation( shaderProgram, "viewMatrix");
-
-  //Ask GL for two Vertex Attribute Objects (vao) , one for the sphere and one for the wireframe
-  glGenVertexArrays (2, vao);
-  //Ask GL for two Vertex Buffer Object (vbo)
-  glGenBuffers (2, vbo);
-
-  //Set 0 as the current array to be used by binding it
-  glBindVertexArray (vao[0]);
-  //Set 0 as the current buffer to be used by binding it
-  glBindBuffer (GL_ARRAY_BUFFER, vbo[0]);
+  vPosition = glGetAttribLocation( shaderProgram, "vPosition" );
+  vColor = glGetAttribLocation( shaderProgram, "vColor" ); 
+  vNormal = glGetAttribLocation( shaderProgram, "vNormal" ); 
+  frame_ubo = csX75::CreateFrameUniformsGL();
+  getUniformsGL();
+
+  // Rebuild the program whenever one of its files is saved
+  shader_reloader = new csX75::ShaderReloader(shaderProgram, vertex_shader_file, fragment_shader_file);
+
+  //Ask GL for two Vertex Attribute Objects (vao) , one for the sphere and one for the wireframe,
+  //the Vertex Buffer Object (vbo) they share, and an index buffer each. Twice over
+  for (int b = 0; b < 2; b++)
+    {
+      glGenVertexArrays (2, sphere_buffers[b].vao);
+      glGenBuffers (1, &sphere_buffers[b].vbo);
+      glGenBuffers (2, sphere_buffers[b].ibo);
+    }
 
   // Call the sphere function
-  Lat = tesselation;
-  Long = tesselation;
-  sphere(Radius, Lat, Long);
-  
-  //Copy the points into the current buffer
-  glBufferData (GL_ARRAY_BUFFER, sizeof (v_positions) + sizeof(v_colors) + sizeof(v_normals), NULL, GL_STATIC_DRAW);
-  glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(v_positions), v_positions );
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(v_positions), sizeof(v_colors), v_colors );
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(v_colors)+sizeof(v_positions), sizeof(v_normals), v_normals );
-  // set up vertex array
-
-  glEnableVertexAttribArray( vPosition );
-  glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-  
-  glEnableVertexAttribArray( vColor );
-  glVertexAttribPointer( vColor, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(v_positions)) );
-
-  glEnableVertexAttribArray( vNormal );
-  glVertexAttribPointer( vNormal, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(v_positions) + sizeof(v_colors)) );
-
-  // For The Wireframe too ... --------
-
-  //Set 1 as the current array to be used by binding it
-  glBindVertexArray (vao[1]);
-  //Set 1 as the current buffer to be used by binding it
-  glBindBuffer (GL_ARRAY_BUFFER, vbo[1]);
-
-    //Copy the points into the current buffer
-  glBufferData (GL_ARRAY_BUFFER, sizeof (w_positions) + sizeof(w_colors) + sizeof(w_normals), NULL, GL_STATIC_DRAW);
-  glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(w_positions), w_positions );
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(w_positions), sizeof(w_colors), w_colors );
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(w_colors)+sizeof(w_positions), sizeof(w_normals), w_normals );
-  
-  // set up vertex array
-
-  glEnableVertexAttribArray( vPosition );
-  glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-  
-  glEnableVertexAttribArray( vColor );
-  glVertexAttribPointer( vColor, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(w_positions)) );
-
-  glEnableVertexAttribArray( vNormal );
-  glVertexAttribPointer( vNormal, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(w_positions) + sizeof(w_colors)) );
-
-
+  sphere(Radius, tesselation);
+  uploadSphereGL(sphere_buffers[front_buffers]);
+  built_tesselation = tesselation;
+  sphere_builder = new csX75::SphereBuilder();
 }
 
 void renderGL(void)
 {
+  updateSphereGL();
+  // Swap in an edited shader once it has been built, the old one is used until then
+  if (shader_reloader->update(shaderProgram))
+    {
+      glUseProgram( shaderProgram );
+      getUniformsGL();
+    }
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   rotation_matrix = glm::rotate(glm::mat4(1.0f), glm::radians(xrot), glm::vec3(1.0f,0.0f,0.0f));
@@ -244,30 +261,78 @@ void renderGL(void)
 
   view_matrix = projection_matrix*lookat_matrix;
 
-  glUniformMatrix4fv(viewMatrix, 1, GL_FALSE, glm::value_ptr(view_matrix));
+  // One upload of the camera serves every draw and every program this frame
+  frame_uniforms.view = lookat_matrix;
+  frame_uniforms.projection = projection_matrix;
+  frame_uniforms.view_projection = view_matrix;
+  frame_uniforms.camera_position = c_pos;
+  csX75::UpdateFrameUniformsGL(frame_ubo, frame_uniforms);
 
+  // Only the model matrix is per object
+  glUniformMatrix4fv(uModelMatrix, 1, GL_FALSE, glm::value_ptr(model_matrix));
+
+  int level = sphereLevel();
   if(wireframe)
     {
-      glPointSize(4);
       // Drawing a Wireframe for SPHERE
-      modelview_matrix = view_matrix*model_matrix;
-      glUniformMatrix4fv(uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(modelview_matrix));
-      glBindVertexArray (vao[1]);
-      glDrawArrays(GL_LINE_STRIP,0,num_vertices);
+      glVertexAttrib4fv(vColor, glm::value_ptr(black));
+      SphereBuffers &buffers = sphere_buffers[front_buffers];
+      glBindVertexArray (buffers.vao[1]);
+      drawIndexRange(GL_LINES, sphere_lods.line_first[level], sphere_lods.line_count[level], buffers.index_type[1]);
     }
 
   // Draw the sphere
   modelview_matrix = view_matrix*model_matrix;
-  glUniformMatrix4fv(uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(modelview_matrix));
   normal_matrix = glm::transpose (glm::inverse(glm::mat3(modelview_matrix)));
   glUniformMatrix3fv(normalMatrix, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-  glBindVertexArray (vao[0]);
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, num_vertices);
+  glVertexAttrib4fv(vColor, glm::value_ptr(white));
+  SphereBuffers &buffers = sphere_buffers[front_buffers];
+  glBindVertexArray (buffers.vao[0]);
+  drawIndexRange(GL_TRIANGLES, sphere_lods.first[level], sphere_lods.count[level], buffers.index_type[0]);
   
 }
 
+//Print how many vertices and triangles the sphere has, the index size and
+//the triangles at each level of detail, when run with --stats
+void printStats(void)
+{
+  std::cout<<"Sphere: "<<sphere_lods.mesh.positions.size()<<" vertices, "<<sphere_lods.count[0] / 3
+	   <<" triangles, "<<(sphere_buffers[0].index_type[0] == GL_UNSIGNED_SHORT ? 16 : 32)<<" bit indices"<<std::endl;
+  std::cout<<"Levels of detail:";
+  for (std::size_t l = 0; l < sphere_lods.count.size(); l++)
+    std::cout<<" "<<sphere_lods.count[l] / 3;
+  std::cout<<" triangles"<<std::endl;
+}
+
 int main(int argc, char** argv)
 {
+  bool headless = csX75::parse_headless_args(argc, argv);
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--icosphere") == 0)
+	use_icosphere = true;
+      else if (strcmp(argv[i], "--stats") == 0)
+	show_stats = true;
+      else
+	tesselation = atoi(argv[i]);
+    }
+
+  //! Render offscreen without a window when asked to (--headless or CSX75_HEADLESS=1)
+  if (headless)
+    {
+      if (!csX75::initHeadlessGL(512, 512))
+	return -1;
+      csX75::initGL();
+      initBuffersGL();
+      if (show_stats)
+	printStats();
+      csX75::runHeadlessGL(renderGL);
+      delete sphere_builder;
+      delete shader_reloader;
+      csX75::terminateHeadlessGL();
+      return 0;
+    }
+
   //! The pointer to the GLFW window
   GLFWwindow* window;
 
@@ -277,8 +342,6 @@ int main(int argc, char** argv)
   //! Initialize GLFW
   if (!glfwInit())
     return -1;
-  if(argc > 1)
-    tesselation = atoi(argv[1]);
   //We want OpenGL 4.0
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); 
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -318,6 +381,8 @@ int main(int argc, char** argv)
   //Initialize GL state
   csX75::initGL();
   initBuffersGL();
+  if (show_stats)
+    printStats();
 
   // Loop until the user closes the window
   while (glfwWindowShouldClose(window) == 0)
@@ -333,6 +398,8 @@ int main(int argc, char** argv)
       glfwPollEvents();
     }
   
+  delete sphere_builder;
+  delete shader_reloader;
   glfwTerminate();
   return 0;
 }
@@ -17,6 +17,10 @@
 
 #include "gl_framework.hpp"
 #include "shader_util.hpp"
+#include "shader_reload.hpp"
+#include "frame_uniforms.hpp"
+#include "sphere_mesh.hpp"
+#include "sphere_builder.hpp"
 #include "glm/vec3.hpp"
 #include "glm/vec4.hpp"
 #include "glm/mat4x4.hpp"
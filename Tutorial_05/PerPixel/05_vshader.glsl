@@ -8,12 +8,19 @@ out vec3 normal;
 out vec4 eye;
 out vec4 COLOR;
 
-uniform mat4 uModelViewMatrix;
+uniform mat4 uModelMatrix;
 uniform mat3 normalMatrix;
-uniform mat4 viewMatrix;
+layout(std140) uniform FrameUniforms
+{
+  mat4 viewMatrix;
+  mat4 projectionMatrix;
+  mat4 viewProjectionMatrix;
+  vec4 cameraPosition;
+};
+
 void main (void) 
 {
-  gl_Position = uModelViewMatrix * vPosition;
+  gl_Position = viewProjectionMatrix * uModelMatrix * vPosition;
   normal = (normalMatrix * normalize(vNormal)); 
   eye = -gl_Position; 
   COLOR = vColor; 
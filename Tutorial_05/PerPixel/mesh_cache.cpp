@@ -0,0 +1,64 @@
+/*
+  CSX75 Tutorial 5 - vertex cache report
+
+  Builds the sphere the way 05_shading does for each tesselation given and
+  reports how well its triangle order uses the post-transform vertex cache
+  (ACMR and ATVR, see mesh_optimize.hpp) as generated and after the
+  vertex cache pass.
+
+  Usage: ./mesh_cache [--icosphere] [--cache N] <amount_of_tesselation> ...
+*/
+
+#include "sphere_mesh.hpp"
+#include "mesh_optimize.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void report(const char* stage, const csX75::IndexedMesh &mesh, unsigned int cache_size)
+{
+  csX75::VertexCacheStats stats = csX75::AnalyzeVertexCache(mesh.triangles, mesh.positions.size(), cache_size);
+  printf("  %-13s ACMR %.3f  ATVR %.3f  (%u vertex shader runs)\n", stage, stats.acmr, stats.atvr,
+	 stats.transforms);
+}
+
+int main(int argc, char** argv)
+{
+  bool use_icosphere = false;
+  unsigned int cache_size = 16;
+  std::vector<int> tesselations;
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--icosphere") == 0)
+	use_icosphere = true;
+      else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+	cache_size = atoi(argv[++i]);
+      else
+	tesselations.push_back(atoi(argv[i]));
+    }
+  if (tesselations.empty() || cache_size == 0)
+    {
+      fprintf(stderr, "Usage: %s [--icosphere] [--cache N] <amount_of_tesselation> ...\n", argv[0]);
+      return 1;
+    }
+
+  for (std::size_t i = 0; i < tesselations.size(); i++)
+    {
+      //The same sphere as 05_shading draws, before it is optimised
+      csX75::IndexedMesh mesh;
+      csX75::MakeSphere(1.0f, tesselations[i], use_icosphere, mesh);
+
+      printf("%s %d: %d vertices, %d triangles, %u entry FIFO cache\n", use_icosphere ? "Icosphere" : "UV sphere",
+	     tesselations[i], (int) mesh.positions.size(), (int) mesh.triangles.size() / 3, cache_size);
+      report("generated", mesh, cache_size);
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      csX75::OptimizeVertexCache(mesh.triangles, mesh.positions.size());
+      double cache_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      report("vertex cache", mesh, cache_size);
+      printf("  the pass took %.2f ms\n", cache_ms);
+    }
+  return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef _MESH_OPTIMIZE_HPP_
+#define _MESH_OPTIMIZE_HPP_
+
+#include <GL/glew.h>
+
+#include <vector>
+
+namespace csX75
+{
+  //! After the vertex shader runs, the GPU keeps the results for the last
+  //! few vertices it shaded, and a triangle whose corners are still there
+  //! does not shade them again. These passes reorder an indexed triangle
+  //! list, three indices a triangle, to make the most of that cache.
+
+  //! Vertex shader runs an index list costs with a FIFO cache of cache_size
+  //! entries. acmr is runs per triangle: 3 without any reuse, 0.5 at best
+  //! on a large closed mesh. atvr is runs per vertex used, 1 at best.
+  struct VertexCacheStats
+  {
+    unsigned int transforms;
+    float acmr;
+    float atvr;
+  };
+  VertexCacheStats AnalyzeVertexCache(const std::vector<GLuint> &indices, std::size_t vertex_count,
+				      unsigned int cache_size);
+
+  //! Tom Forsyth's linear-speed vertex cache optimisation: emit the triangle
+  //! whose corners score best, favouring vertices recently used and vertices
+  //! with few triangles left, so the order sweeps the mesh in narrow strips.
+  void OptimizeVertexCache(std::vector<GLuint> &indices, std::size_t vertex_count);
+
+  //! Renumber the vertices in the order the indices first use them, so the
+  //! vertex fetches walk forward through memory. Returns remap, the new
+  //! index of each old vertex, to reorder the vertex arrays with
+  //! RemapVertices. Unused vertices go to the end.
+  std::vector<GLuint> OptimizeVertexFetch(std::vector<GLuint> &indices, std::size_t vertex_count);
+
+  template <typename T>
+  void RemapVertices(std::vector<T> &vertices, const std::vector<GLuint> &remap)
+  {
+    std::vector<T> moved(vertices.size());
+    for (std::size_t v = 0; v < vertices.size(); v++)
+      moved[remap[v]] = vertices[v];
+    vertices.swap(moved);
+  }
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include "shader_reload.hpp"
+
+#include <cerrno>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace csX75
+{
+  ShaderReloader::ShaderReloader(GLuint program, const std::string &vertex_file, const std::string &fragment_file)
+    : vertex_file(vertex_file), fragment_file(fragment_file), context(NULL),
+      inotify_fd(-1), wake_fd(-1), ready_program(0), ready_fence(NULL)
+  {
+    //!The VAOs were set up against these locations, a rebuilt program has to keep them
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+    std::vector<GLchar> name(max_length + 1);
+    for (GLint i = 0; i < count; i++)
+      {
+	GLint size;
+	GLenum type;
+	glGetActiveAttrib(program, i, max_length + 1, NULL, &size, &type, name.data());
+	AttribBinding binding;
+	binding.name = name.data();
+	binding.location = glGetAttribLocation(program, name.data());
+	if (binding.location >= 0)
+	  attribs.push_back(binding);
+      }
+
+    //!Editors often save by writing a new file and renaming it over the old one,
+    //!so watch the directories and match the names
+    inotify_fd = inotify_init1(IN_CLOEXEC);
+    const std::string* files[2] = { &this->vertex_file, &this->fragment_file };
+    for (int i = 0; i < 2 && inotify_fd >= 0; i++)
+      {
+	size_t slash = files[i]->rfind('/');
+	std::string dir = slash == std::string::npos ? "." : files[i]->substr(0, slash + 1);
+	WatchedFile file;
+	file.wd = inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	file.name = slash == std::string::npos ? *files[i] : files[i]->substr(slash + 1);
+	if (file.wd >= 0)
+	  watched.push_back(file);
+      }
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (inotify_fd < 0 || watched.size() != 2 || wake_fd < 0)
+      {
+	std::cerr<<"Cannot watch "<<vertex_file<<" and "<<fragment_file<<", shaders will not be reloaded"<<std::endl;
+	return;
+      }
+
+    context = createSharedContextGL();
+    if (context != NULL)
+      worker = std::thread(&ShaderReloader::worker_loop, this);
+  }
+
+  ShaderReloader::~ShaderReloader()
+  {
+    if (worker.joinable())
+      {
+	uint64_t one = 1;
+	if (write(wake_fd, &one, sizeof(one)) != sizeof(one))
+	  std::cerr<<"Cannot stop the shader reloader"<<std::endl;
+	worker.join();
+      }
+    destroySharedContextGL(context);
+    if (inotify_fd >= 0)
+      close(inotify_fd);
+    if (wake_fd >= 0)
+      close(wake_fd);
+
+    if (ready_program != 0)
+      {
+	glDeleteSync(ready_fence);
+	glDeleteProgram(ready_program);
+      }
+  }
+
+  bool ShaderReloader::update(GLuint &program)
+  {
+    GLuint rebuilt;
+    {
+      std::lock_guard<std::mutex> lock(ready_mutex);
+      if (ready_program == 0)
+	return false;
+      //!Linked on the other context, but not necessarily done there yet - never wait here
+      if (glClientWaitSync(ready_fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+	return false;
+      glDeleteSync(ready_fence);
+      rebuilt = ready_program;
+      ready_program = 0;
+      ready_fence = NULL;
+    }
+
+    glDeleteProgram(program);
+    program = rebuilt;
+    std::cout<<"Reloaded "<<vertex_file<<" and "<<fragment_file<<std::endl;
+    return true;
+  }
+
+  bool ShaderReloader::wait_for_change(void)
+  {
+    struct pollfd fds[2];
+    fds[0].fd = inotify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fd;
+    fds[1].events = POLLIN;
+
+    //!A save can be several events, so after the first one wait until 50 ms pass without any
+    bool changed = false;
+    int timeout = -1;
+    for (;;)
+      {
+	int ready = poll(fds, 2, timeout);
+	if (ready < 0 && errno == EINTR)
+	  continue;
+	if (ready < 0 || (fds[1].revents & POLLIN))
+	  return false;
+	if (ready == 0)
+	  return true;
+
+	alignas(struct inotify_event) char buffer[4096];
+	ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+	for (ssize_t offset = 0; offset < length; )
+	  {
+	    const struct inotify_event* event = (const struct inotify_event*) (buffer + offset);
+	    for (size_t i = 0; i < watched.size(); i++)
+	      if (event->len > 0 && event->wd == watched[i].wd && watched[i].name == event->name)
+		changed = true;
+	    offset += sizeof(struct inotify_event) + event->len;
+	  }
+	if (changed)
+	  timeout = 50;
+      }
+  }
+
+  GLuint ShaderReloader::rebuild(void)
+  {
+    std::vector<GLuint> shaderList;
+    try
+      {
+	shaderList.push_back(LoadShaderGL(GL_VERTEX_SHADER, vertex_file));
+	shaderList.push_back(LoadShaderGL(GL_FRAGMENT_SHADER, fragment_file));
+      }
+    catch(std::exception &e)
+      {
+	std::cerr<<e.what()<<std::endl;
+	for (size_t i = 0; i < shaderList.size(); i++)
+	  glDeleteShader(shaderList[i]);
+	return 0;
+      }
+
+    GLuint program = CreateProgramGL(shaderList);
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+    //!Relink with the old locations bound if the driver put an attribute elsewhere
+    bool moved = false;
+    for (size_t i = 0; status == GL_TRUE && i < attribs.size(); i++)
+      {
+	GLint location = glGetAttribLocation(program, attribs[i].name.c_str());
+	if (location >= 0 && location != attribs[i].location)
+	  moved = true;
+      }
+    if (moved)
+      {
+	for (size_t i = 0; i < shaderList.size(); i++)
+	  {
+	    //!Not compiled yet if the program came out of the shader cache
+	    GLint compiled;
+	    glGetShaderiv(shaderList[i], GL_COMPILE_STATUS, &compiled);
+	    if (compiled == GL_FALSE)
+	      glCompileShader(shaderList[i]);
+	    glAttachShader(program, shaderList[i]);
+	  }
+	for (size_t i = 0; i < attribs.size(); i++)
+	  glBindAttribLocation(program, attribs[i].location, attribs[i].name.c_str());
+	glLinkProgram(program);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	for (size_t i = 0; i < shaderList.size(); i++)
+	  glDetachShader(program, shaderList[i]);
+      }
+
+    for (size_t i = 0; i < shaderList.size(); i++)
+      glDeleteShader(shaderList[i]);
+    if (status == GL_FALSE)
+      {
+	glDeleteProgram(program);
+	return 0;
+      }
+    return program;
+  }
+
+  void ShaderReloader::worker_loop(void)
+  {
+    if (!makeSharedContextCurrentGL(context))
+      {
+	std::cerr<<"Cannot use the shared context, shaders will not be reloaded"<<std::endl;
+	return;
+      }
+
+    while (wait_for_change())
+      {
+	GLuint program = rebuild();
+	if (program == 0)
+	  {
+	    std::cerr<<"Keeping the old program"<<std::endl;
+	    continue;
+	  }
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	//!A later save replaces a program update() has not taken yet
+	std::lock_guard<std::mutex> lock(ready_mutex);
+	if (ready_program != 0)
+	  {
+	    glDeleteSync(ready_fence);
+	    glDeleteProgram(ready_program);
+	  }
+	ready_program = program;
+	ready_fence = fence;
+      }
+
+    makeSharedContextCurrentGL(NULL);
+  }
+};
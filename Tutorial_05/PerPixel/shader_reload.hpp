@@ -0,0 +1,62 @@
+#ifndef _SHADER_RELOAD_HPP_
+#define _SHADER_RELOAD_HPP_
+
+#include "gl_framework.hpp"
+#include "shader_util.hpp"
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace csX75
+{
+  //! Watches the shader files of a program with inotify, and when one is saved
+  //! rebuilds the program on a thread of its own with a shared context. The render
+  //! loop picks the new program up with update() at the start of a frame once the
+  //! GPU has it, so it never waits for a compile. A shader that does not compile
+  //! or link is reported and the old program is kept.
+  class ShaderReloader
+  {
+  public:
+    //! program is the one made from these two files, its attributes keep their locations
+    ShaderReloader(GLuint program, const std::string &vertex_file, const std::string &fragment_file);
+    ~ShaderReloader();
+
+    //! Swap in a rebuilt program: deletes the old one, returns true if program changed.
+    //! Uniform locations must be looked up again after a swap.
+    bool update(GLuint &program);
+
+  private:
+    struct AttribBinding
+    {
+      std::string name;
+      GLint location;
+    };
+    struct WatchedFile
+    {
+      int wd;
+      std::string name;
+    };
+
+    void worker_loop(void);
+    //! Wait until a watched file is saved and then quiet for a moment, false when stopping
+    bool wait_for_change(void);
+    GLuint rebuild(void);
+
+    std::string vertex_file, fragment_file;
+    std::vector<AttribBinding> attribs;
+    std::vector<WatchedFile> watched;
+
+    SharedContextGL* context;
+    int inotify_fd, wake_fd;
+    std::thread worker;
+
+    //!Rebuilt program waiting for update(), and the fence that says the GPU has it
+    std::mutex ready_mutex;
+    GLuint ready_program;
+    GLsync ready_fence;
+  };
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "sphere_builder.hpp"
+
+namespace csX75
+{
+  SphereBuilder::SphereBuilder()
+    : stopping(false), wanted(false), radius(1.0f), tesselation(0), icosphere(false), built(false)
+  {
+    worker = std::thread(&SphereBuilder::worker_loop, this);
+  }
+
+  SphereBuilder::~SphereBuilder()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+  }
+
+  void SphereBuilder::request(float a_radius, int a_tesselation, bool a_icosphere)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      wanted = true;
+      radius = a_radius;
+      tesselation = a_tesselation;
+      icosphere = a_icosphere;
+    }
+    wake.notify_one();
+  }
+
+  bool SphereBuilder::update(SphereLODs &lods)
+  {
+    //!Never waits on the worker for longer than it takes to swap a few vectors
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!built)
+      return false;
+    std::swap(lods, finished);
+    built = false;
+    return true;
+  }
+
+  void SphereBuilder::worker_loop(void)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+      {
+	wake.wait(lock, [this] { return stopping || wanted; });
+	if (stopping)
+	  return;
+	float r = radius;
+	int tess = tesselation;
+	bool ico = icosphere;
+	wanted = false;
+
+	//!The levels are made without the lock, request() and update() go on meanwhile
+	lock.unlock();
+	SphereLODs lods;
+	MakeSphereLODs(r, tess, ico, lods);
+	lock.lock();
+
+	std::swap(finished, lods);
+	built = true;
+      }
+  }
+};
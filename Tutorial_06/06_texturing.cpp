@@ -12,10 +12,17 @@
 
 #include "06_texturing.hpp"
 #include "texture.hpp"
+#include "texture_stream.hpp"
+#include "vertex_layout.hpp"
 
 GLuint shaderProgram;
 GLuint vbo[2], vao[2];
 GLuint tex;
+//Textures load in the background, tex_handle names the cube's texture in the streamer
+csX75::TextureStreamer* texture_streamer;
+int tex_handle;
+//Anisotropic filtering, off unless asked for with --anisotropy N
+float max_anisotropy = 1.0f;
 
 glm::mat4 rotation_matrix;
 glm::mat4 projection_matrix;
@@ -150,17 +157,16 @@ void initBuffersGL(void)
   glUseProgram( shaderProgram );
 
   // getting the attributes from the shader program
-  GLuint vPosition = glGetAttribLocation( shaderProgram, "vPosition" );
-  GLuint vColor = glGetAttribLocation( shaderProgram, "vColor" ); 
-  GLuint vNormal = glGetAttribLocation( shaderProgram, "vNormal" ); 
-  GLuint texCoord = glGetAttribLocation( shaderProgram, "texCoord" ); 
+  GLint vPosition = glGetAttribLocation( shaderProgram, "vPosition" );
+  GLint vNormal = glGetAttribLocation( shaderProgram, "vNormal" ); 
+  GLint texCoord = glGetAttribLocation( shaderProgram, "texCoord" ); 
   uModelViewMatrix = glGetUniformLocation( shaderProgram, "uModelViewMatrix");
   normalMatrix =  glGetUniformLocation( shaderProgram, "normalMatrix");
   viewMatrix = glGetUniformLocation( shaderProgram, "viewMatrix");
 
-  // Load Textures 
-  GLuint tex=LoadTexture("images/all1.bmp",256,256);
-  glBindTexture(GL_TEXTURE_2D, tex);
+  // Load Textures - drawing starts at once with a grey placeholder until the image is in
+  texture_streamer = new csX75::TextureStreamer(0);
+  tex_handle = texture_streamer->request("images/all1.bmp", TEXTURE_MIPMAP_BOX, max_anisotropy);
 
   //Ask GL for two Vertex Attribute Objects (vao) , one for the sphere and one for the wireframe
   glGenVertexArrays (2, vao);
@@ -174,22 +180,26 @@ void initBuffersGL(void)
 
   colorcube();
 
-  //Copy the points into the current buffer
-  glBufferData (GL_ARRAY_BUFFER, sizeof (v_positions) + sizeof(tex_coords) + sizeof(v_normals), NULL, GL_STATIC_DRAW);
-  glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(v_positions), v_positions );
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(v_positions), sizeof(tex_coords), tex_coords);
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(tex_coords)+sizeof(v_positions), sizeof(v_normals), v_normals );
-  // set up vertex array
-  //Position
-  glEnableVertexAttribArray( vPosition );
-  glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-  //Textures
-  glEnableVertexAttribArray( texCoord );
-  glVertexAttribPointer( texCoord, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(v_positions)) );
-
-  //Normal
-  glEnableVertexAttribArray( vNormal );
-  glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(v_positions)+sizeof(tex_coords)) );
+  //Copy the points into the current buffer, each vertex in one piece: the
+  //position as three floats, the texture coordinates as two half floats and
+  //the normal in 10 bits a component, 20 bytes where a vec4, a vec2 and a
+  //vec4 took 40
+  csX75::VertexLayout layout;
+  layout.add(csX75::VERTEX_FLOAT3);
+  layout.add(csX75::VERTEX_HALF2);
+  layout.add(csX75::VERTEX_SNORM10);
+  std::vector<unsigned char> vertices(num_vertices * layout.stride());
+  for (int v = 0; v < num_vertices; v++)
+    {
+      unsigned char* vertex = &vertices[v * layout.stride()];
+      layout.pack(vertex, 0, v_positions[v]);
+      layout.pack(vertex, 1, glm::vec4(tex_coords[v], 0.0, 0.0));
+      layout.pack(vertex, 2, v_normals[v]);
+    }
+  glBufferData (GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+  // set up vertex array, skipping the attributes the shader does not read
+  GLint locations[3] = { vPosition, texCoord, vNormal };
+  layout.setupGL(locations);
 
   
 
@@ -228,7 +238,8 @@ void renderGL(void)
   glUniformMatrix4fv(uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(modelview_matrix));
   normal_matrix = glm::transpose (glm::inverse(glm::mat3(modelview_matrix)));
   glUniformMatrix3fv(normalMatrix, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-  //  glBindTexture(GL_TEXTURE_2D, tex);
+  texture_streamer->update();
+  glBindTexture(GL_TEXTURE_2D, texture_streamer->texture(tex_handle));
   glBindVertexArray (vao[0]);
   glDrawArrays(GL_TRIANGLES, 0, num_vertices);
   
@@ -236,6 +247,24 @@ void renderGL(void)
 
 int main(int argc, char** argv)
 {
+  bool headless = csX75::parse_headless_args(argc, argv);
+  for (int i = 1; i < argc; i++)
+    if (strcmp(argv[i], "--anisotropy") == 0 && i + 1 < argc)
+      max_anisotropy = atof(argv[++i]);
+
+  //! Render offscreen without a window when asked to (--headless or CSX75_HEADLESS=1)
+  if (headless)
+    {
+      if (!csX75::initHeadlessGL(512, 512))
+	return -1;
+      csX75::initGL();
+      initBuffersGL();
+      csX75::runHeadlessGL(renderGL);
+      delete texture_streamer;
+      csX75::terminateHeadlessGL();
+      return 0;
+    }
+
   //! The pointer to the GLFW window
   GLFWwindow* window;
 
@@ -298,7 +327,8 @@ int main(int argc, char** argv)
       // Poll for and process events
       glfwPollEvents();
     }
-  
+
+  delete texture_streamer;
   glfwTerminate();
   return 0;
 }
@@ -0,0 +1,281 @@
+#include "gl_framework.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "texture.hpp"
+#include "atlas.hpp"
+
+//One source rectangle and where the packer put it, gutter included
+struct AtlasItem
+{
+  int image;
+  int x, y, w, h;           // rectangle in the source image
+  int padded_w, padded_h;   // with the gutter on every side
+  int atlas_x, atlas_y;     // bottom left of the padded rectangle in the atlas
+};
+
+static bool sort_by_height( const AtlasItem* a, const AtlasItem* b )
+{
+  if ( a->padded_h != b->padded_h )
+    return a->padded_h > b->padded_h;
+  return a->padded_w > b->padded_w;
+}
+
+//Shelf packing: items, tallest first, go left to right along a shelf as tall as
+//its first item, and a new shelf opens above when the row is full. Returns the
+//height used for a given width.
+static int pack_shelves( std::vector<AtlasItem*>& items, int width )
+{
+  int x = 0, y = 0, shelf_h = 0;
+  for ( size_t i = 0; i < items.size(); i++ )
+    {
+      if ( x + items[i]->padded_w > width )
+	{
+	  y += shelf_h;
+	  x = 0;
+	  shelf_h = 0;
+	}
+      items[i]->atlas_x = x;
+      items[i]->atlas_y = y;
+      x += items[i]->padded_w;
+      shelf_h = std::max( shelf_h, items[i]->padded_h );
+    }
+  return y + shelf_h;
+}
+
+//Rows stay 4 byte aligned for both BMP and GL_UNPACK_ALIGNMENT
+static int round_up4( int n )
+{
+  return (n + 3) & ~3;
+}
+
+bool BuildAtlas( const std::vector<std::string>& sources, int gutter,
+		 AtlasImage& atlas, std::vector<AtlasRegion>& regions )
+{
+    if ( sources.empty() )
+      return false;
+    if ( gutter < 0 )
+      gutter = 0;
+
+    // The same file may be named several times with different rectangles, map it once
+    std::vector<std::string> files;
+    std::vector<BMPImage> images;
+    std::vector<AtlasItem> items( sources.size() );
+    bool ok = true;
+    for ( size_t i = 0; i < sources.size() && ok; i++ )
+      {
+	std::string file = sources[i];
+	int x = 0, y = 0, w = -1, h = -1;
+	size_t colon = file.rfind( ':' );
+	if ( colon != std::string::npos )
+	  {
+	    if ( sscanf( file.c_str() + colon + 1, "%d,%d,%d,%d", &x, &y, &w, &h ) != 4 )
+	      {
+		printf("Bad atlas source %s, expected file.bmp:x,y,w,h\n", sources[i].c_str());
+		ok = false;
+		break;
+	      }
+	    file = file.substr( 0, colon );
+	  }
+
+	size_t image = std::find( files.begin(), files.end(), file ) - files.begin();
+	if ( image == files.size() )
+	  {
+	    BMPImage bmp;
+	    if ( !MapBMP( file.c_str(), bmp ) )
+	      {
+		ok = false;
+		break;
+	      }
+	    files.push_back( file );
+	    images.push_back( bmp );
+	  }
+
+	if ( w < 0 )
+	  {
+	    w = images[image].width;
+	    h = images[image].height;
+	  }
+	if ( x < 0 || y < 0 || w <= 0 || h <= 0 ||
+	     x + w > images[image].width || y + h > images[image].height )
+	  {
+	    printf("Atlas source %s lies outside the %dx%d image\n", sources[i].c_str(),
+		   images[image].width, images[image].height);
+	    ok = false;
+	    break;
+	  }
+
+	AtlasItem& item = items[i];
+	item.image = (int) image;
+	item.x = x;
+	item.y = y;
+	item.w = w;
+	item.h = h;
+	item.padded_w = w + 2 * gutter;
+	item.padded_h = h + 2 * gutter;
+      }
+
+    if ( ok )
+      {
+	std::vector<AtlasItem*> order;
+	long long area = 0;
+	int min_width = 0, max_width = 0;
+	for ( size_t i = 0; i < items.size(); i++ )
+	  {
+	    order.push_back( &items[i] );
+	    area += (long long) items[i].padded_w * items[i].padded_h;
+	    min_width = std::max( min_width, items[i].padded_w );
+	    max_width += items[i].padded_w;
+	  }
+	std::stable_sort( order.begin(), order.end(), sort_by_height );
+
+	// Try every width from the widest item to a single row and keep the smallest
+	// atlas, preferring the squarer one on a tie
+	int best_w = 0, best_h = 0;
+	for ( int w = round_up4( min_width ); w <= round_up4( max_width ); w += 4 )
+	  {
+	    int h = round_up4( pack_shelves( order, w ) );
+	    long long best = (long long) best_w * best_h, size = (long long) w * h;
+	    if ( best_w == 0 || size < best || (size == best && std::abs( w - h ) < std::abs( best_w - best_h )) )
+	      {
+		best_w = w;
+		best_h = h;
+	      }
+	    if ( (long long) w * w > 4 * area && w > best_h )
+	      break; // only getting wider and flatter from here
+	  }
+	pack_shelves( order, best_w );
+
+	atlas.width = best_w;
+	atlas.height = best_h;
+	atlas.bytes_per_pixel = 3;
+	for ( size_t i = 0; i < images.size(); i++ )
+	  atlas.bytes_per_pixel = std::max( atlas.bytes_per_pixel, images[i].bytes_per_pixel );
+	atlas.stride = round_up4( atlas.width * atlas.bytes_per_pixel );
+	atlas.pixels.assign( (size_t) atlas.stride * atlas.height, 0 );
+
+	// Copy each rectangle with its gutter, clamping to the rectangle's edge
+	int bpp = atlas.bytes_per_pixel;
+	regions.resize( items.size() );
+	for ( size_t i = 0; i < items.size(); i++ )
+	  {
+	    const AtlasItem& item = items[i];
+	    const BMPImage& image = images[item.image];
+	    for ( int dy = 0; dy < item.padded_h; dy++ )
+	      {
+		int sy = item.y + std::min( std::max( dy - gutter, 0 ), item.h - 1 );
+		if ( image.top_down )
+		  sy = image.height - 1 - sy;
+		const unsigned char* src_row = image.pixels + (size_t) sy * image.stride;
+		unsigned char* dst = &atlas.pixels[(size_t) (item.atlas_y + dy) * atlas.stride + item.atlas_x * bpp];
+		for ( int dx = 0; dx < item.padded_w; dx++, dst += bpp )
+		  {
+		    int sx = item.x + std::min( std::max( dx - gutter, 0 ), item.w - 1 );
+		    const unsigned char* src = src_row + sx * image.bytes_per_pixel;
+		    dst[0] = src[0];
+		    dst[1] = src[1];
+		    dst[2] = src[2];
+		    if ( bpp == 4 )
+		      dst[3] = image.bytes_per_pixel == 4 ? src[3] : 255;
+		  }
+	      }
+
+	    AtlasRegion& region = regions[i];
+	    region.name = sources[i];
+	    region.u0 = (float) (item.atlas_x + gutter) / atlas.width;
+	    region.v0 = (float) (item.atlas_y + gutter) / atlas.height;
+	    region.u1 = (float) (item.atlas_x + gutter + item.w) / atlas.width;
+	    region.v1 = (float) (item.atlas_y + gutter + item.h) / atlas.height;
+	  }
+      }
+
+    for ( size_t i = 0; i < images.size(); i++ )
+      UnmapBMP( images[i] );
+    return ok;
+}
+
+static void put_u16( unsigned char* p, unsigned int v )
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32( unsigned char* p, unsigned int v )
+{
+  put_u16( p, v & 0xffff );
+  put_u16( p + 2, v >> 16 );
+}
+
+bool SaveAtlas( const char* bmp_filename, const char* uv_filename,
+		const AtlasImage& atlas, const std::vector<AtlasRegion>& regions )
+{
+    // 14 byte file header and a 40 byte BITMAPINFOHEADER, then the rows as they are
+    unsigned char header[54];
+    memset( header, 0, sizeof(header) );
+    size_t data_size = atlas.pixels.size();
+    header[0] = 'B';
+    header[1] = 'M';
+    put_u32( header + 0x02, (unsigned int) (sizeof(header) + data_size) );
+    put_u32( header + 0x0A, sizeof(header) );
+    put_u32( header + 0x0E, 40 );
+    put_u32( header + 0x12, atlas.width );
+    put_u32( header + 0x16, atlas.height );
+    put_u16( header + 0x1A, 1 );
+    put_u16( header + 0x1C, atlas.bytes_per_pixel * 8 );
+    put_u32( header + 0x22, (unsigned int) data_size );
+
+    FILE* file = fopen( bmp_filename, "wb" );
+    if ( file == NULL )
+      {
+	printf("Cannot write %s\n", bmp_filename);
+	return false;
+      }
+    bool ok = fwrite( header, sizeof(header), 1, file ) == 1 &&
+      fwrite( atlas.pixels.data(), 1, data_size, file ) == data_size;
+    ok = fclose( file ) == 0 && ok;
+
+    std::ofstream table( uv_filename );
+    table.precision( 9 );
+    table<<"# "<<atlas.width<<"x"<<atlas.height<<" atlas "<<bmp_filename<<std::endl;
+    table<<"# name u0 v0 u1 v1"<<std::endl;
+    for ( size_t i = 0; i < regions.size(); i++ )
+      table<<regions[i].name<<" "<<regions[i].u0<<" "<<regions[i].v0<<" "
+	   <<regions[i].u1<<" "<<regions[i].v1<<std::endl;
+    table.close();
+    if ( !ok || !table )
+      {
+	printf("Cannot write %s\n", ok ? uv_filename : bmp_filename);
+	return false;
+      }
+    return true;
+}
+
+bool LoadAtlasUV( const char* uv_filename, std::vector<AtlasRegion>& regions )
+{
+    std::ifstream table( uv_filename );
+    if ( !table.is_open() )
+      {
+	printf("Cannot open %s\n", uv_filename);
+	return false;
+      }
+
+    regions.clear();
+    std::string line;
+    while ( std::getline( table, line ) )
+      {
+	if ( line.empty() || line[0] == '#' )
+	  continue;
+	std::istringstream fields( line );
+	AtlasRegion region;
+	if ( !(fields >> region.name >> region.u0 >> region.v0 >> region.u1 >> region.v1) )
+	  {
+	    printf("Bad line in %s: %s\n", uv_filename, line.c_str());
+	    return false;
+	  }
+	regions.push_back( region );
+      }
+    return !regions.empty();
+}
@@ -0,0 +1,40 @@
+#ifndef _ATLAS_HPP_
+#define _ATLAS_HPP_
+
+#include <string>
+#include <vector>
+
+//! Where one source image ended up in an atlas, in texture coordinates.
+//! (u0, v0) is the bottom left corner, (u1, v1) the top right.
+struct AtlasRegion
+{
+  std::string name;
+  float u0, v0, u1, v1;
+};
+
+//! A packed atlas in BMP pixel order - BGR or BGRA, bottom row first,
+//! rows padded to 4 bytes.
+struct AtlasImage
+{
+  int width, height;
+  int bytes_per_pixel;
+  int stride;
+  std::vector<unsigned char> pixels;
+};
+
+//! Pack the source images into one atlas, each surrounded by gutter texels
+//! copied from its own edge so that filtering and the smaller mipmaps do not
+//! pull in the neighbours. A source is a BMP file name, optionally followed by
+//! ":x,y,w,h" to take only that rectangle (x, y from the bottom left).
+//! Regions come back in the order of the sources.
+bool BuildAtlas( const std::vector<std::string>& sources, int gutter,
+		 AtlasImage& atlas, std::vector<AtlasRegion>& regions );
+
+//! Write the atlas as a BMP and its regions as a text table, one "name u0 v0 u1 v1" per line
+bool SaveAtlas( const char* bmp_filename, const char* uv_filename,
+		const AtlasImage& atlas, const std::vector<AtlasRegion>& regions );
+
+//! Read a table written by SaveAtlas
+bool LoadAtlasUV( const char* uv_filename, std::vector<AtlasRegion>& regions );
+
+#endif
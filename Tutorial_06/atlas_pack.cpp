@@ -0,0 +1,54 @@
+/*
+  CSX75 Tutorial 6 - texture atlas packer
+
+  Packs several BMP images (or rectangles cut out of them) into one atlas
+  BMP with gutters between them, and writes the texture coordinates of
+  every piece to a table that the program reads back with LoadAtlasUV.
+
+  Usage: ./atlas_pack [--gutter N] atlas.bmp atlas.uv source.bmp[:x,y,w,h] ...
+*/
+
+#include "gl_framework.hpp"
+#include "texture.hpp"
+#include "atlas.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//gl_framework's keyboard callback moves these, there is no keyboard here
+GLfloat xrot,yrot,zrot,c_xrot,c_yrot,c_zrot;
+bool enable_perspective;
+
+int main(int argc, char** argv)
+{
+  int gutter = 8;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--gutter") == 0 && i + 1 < argc)
+	gutter = atoi(argv[++i]);
+      else
+	args.push_back(argv[i]);
+    }
+  if (args.size() < 3)
+    {
+      fprintf(stderr, "Usage: %s [--gutter N] atlas.bmp atlas.uv source.bmp[:x,y,w,h] ...\n", argv[0]);
+      return 1;
+    }
+
+  std::vector<std::string> sources(args.begin() + 2, args.end());
+  AtlasImage atlas;
+  std::vector<AtlasRegion> regions;
+  if (!BuildAtlas(sources, gutter, atlas, regions) ||
+      !SaveAtlas(args[0].c_str(), args[1].c_str(), atlas, regions))
+    return 1;
+
+  //How much of the atlas holds texels rather than gutter or empty space
+  double used = 0.0;
+  for (size_t i = 0; i < regions.size(); i++)
+    used += (regions[i].u1 - regions[i].u0) * (regions[i].v1 - regions[i].v0);
+  printf("%d images packed into a %dx%d atlas with a %d texel gutter, %.1f%% used\n",
+	 (int) regions.size(), atlas.width, atlas.height, gutter, 100.0 * used);
+  return 0;
+}
@@ -0,0 +1,143 @@
+/*
+  CSX75 Tutorial 6 - offline texture compressor
+
+  Compresses a BMP to BC1, BC3 or ETC2 with a box filtered mip chain and
+  writes it as a KTX file, which LoadTexture uploads as it is with
+  glCompressedTexImage2D. --verify loads the result back through
+  LoadTexture in an offscreen context and prints the PSNR of the first
+  level against the source.
+
+  Usage: ./bmp2ktx [--format bc1|bc3|etc2] [--no-mipmaps] [--verify] in.bmp out.ktx
+*/
+
+#include "gl_framework.hpp"
+#include "texture.hpp"
+#include "texture_compress.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//gl_framework's keyboard callback moves these, there is no keyboard here
+GLfloat xrot,yrot,zrot,c_xrot,c_yrot,c_zrot;
+bool enable_perspective;
+
+//Decode the first level of the KTX file with the driver and compare it to the
+//bottom-up source rows
+static bool verify(const char* filename, const std::vector<unsigned char>& source,
+		   int width, int height, int stride, int bytes_per_pixel)
+{
+  if (!csX75::initHeadlessGL(64, 64))
+    return false;
+  GLuint tex = LoadTexture(filename, width, height);
+  if (tex == 0)
+    {
+      csX75::terminateHeadlessGL();
+      return false;
+    }
+
+  std::vector<unsigned char> decoded((size_t) width * height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, decoded.data());
+
+  double error = 0.0;
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+      {
+	const unsigned char* a = &source[(size_t) y * stride + x * bytes_per_pixel];
+	const unsigned char* b = &decoded[((size_t) y * width + x) * 4];
+	for (int c = 0; c < 3; c++)
+	  error += (double) (a[c] - b[c]) * (a[c] - b[c]);
+      }
+  double mse = error / ((double) width * height * 3);
+  if (mse > 0.0)
+    printf("decoded by GL: PSNR %.2f dB\n", 10.0 * log10(255.0 * 255.0 / mse));
+  else
+    printf("decoded by GL: identical\n");
+
+  FreeTexture(tex);
+  csX75::terminateHeadlessGL();
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  CompressedFormat format = COMPRESS_BC1;
+  bool mipmaps = true, check = false;
+  std::vector<const char*> args;
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+	{
+	  i++;
+	  if (strcmp(argv[i], "bc1") == 0)
+	    format = COMPRESS_BC1;
+	  else if (strcmp(argv[i], "bc3") == 0)
+	    format = COMPRESS_BC3;
+	  else if (strcmp(argv[i], "etc2") == 0)
+	    format = COMPRESS_ETC2;
+	  else
+	    {
+	      fprintf(stderr, "Unknown format %s, expected bc1, bc3 or etc2\n", argv[i]);
+	      return 1;
+	    }
+	}
+      else if (strcmp(argv[i], "--no-mipmaps") == 0)
+	mipmaps = false;
+      else if (strcmp(argv[i], "--verify") == 0)
+	check = true;
+      else
+	args.push_back(argv[i]);
+    }
+  if (args.size() != 2)
+    {
+      fprintf(stderr, "Usage: %s [--format bc1|bc3|etc2] [--no-mipmaps] [--verify] in.bmp out.ktx\n", argv[0]);
+      return 1;
+    }
+
+  BMPImage image;
+  if (!MapBMP(args[0], image))
+    return 1;
+  int width = image.width, height = image.height, bpp = image.bytes_per_pixel;
+  int stride = image.stride;
+
+  //Level 0 bottom row first, as GL and the box filter expect
+  std::vector<unsigned char> level0((size_t) stride * height);
+  for (int y = 0; y < height; y++)
+    memcpy(&level0[(size_t) y * stride],
+	   image.pixels + (size_t) (image.top_down ? height - 1 - y : y) * stride, stride);
+  std::vector<unsigned char> chain;
+  if (mipmaps)
+    BuildBoxMipmaps(image, chain);
+  UnmapBMP(image);
+
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  int levels = mipmaps ? MipLevels(width, height) : 1;
+  std::vector< std::vector<unsigned char> > compressed(levels);
+  CompressImage(format, level0.data(), width, height, stride, bpp, compressed[0]);
+  //The box levels are tightly packed
+  size_t offset = 0;
+  for (int level = 1, w = width, h = height; level < levels; level++)
+    {
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+      CompressImage(format, &chain[offset], w, h, w * bpp, bpp, compressed[level]);
+      offset += (size_t) w * h * bpp;
+    }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+  if (!WriteKTX(args[1], format, width, height, compressed))
+    return 1;
+
+  size_t raw = level0.size() + chain.size(), packed = 0;
+  for (int level = 0; level < levels; level++)
+    packed += compressed[level].size();
+  printf("%s: %dx%d, %d levels, %zu -> %zu bytes (%.1fx) in %.1f ms\n", args[1], width, height,
+	 levels, raw, packed, (double) raw / packed, ms);
+
+  if (check && !verify(args[1], level0, width, height, stride, bpp))
+    return 1;
+  return 0;
+}
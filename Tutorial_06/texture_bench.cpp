@@ -0,0 +1,194 @@
+/*
+  CSX75 Tutorial 6 - texture sampler benchmark
+
+  Renders offscreen (no window needed) two scenes that minify a texture
+  heavily - a screen filling quad tiling the texture many times, and a
+  ground plane running off to the horizon - once for every filtering mode
+  of LoadTexture, and prints the load time and the sampling rate.
+
+  Usage: ./texture_bench [--frames N] [image.bmp]
+*/
+
+#include "gl_framework.hpp"
+#include "shader_util.hpp"
+#include "texture.hpp"
+#include "glm/vec3.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//gl_framework's keyboard callback moves these, there is no keyboard here
+GLfloat xrot,yrot,zrot,c_xrot,c_yrot,c_zrot;
+bool enable_perspective;
+
+static const char* vertex_shader =
+  "#version 330\n"
+  "in vec3 vPosition;\n"
+  "in vec2 texCoord;\n"
+  "out vec2 tex;\n"
+  "uniform mat4 uModelViewMatrix;\n"
+  "void main (void)\n"
+  "{\n"
+  "  gl_Position = uModelViewMatrix * vec4(vPosition, 1.0);\n"
+  "  tex = texCoord;\n"
+  "}\n";
+
+static const char* fragment_shader =
+  "#version 330\n"
+  "in vec2 tex;\n"
+  "out vec4 frag_color;\n"
+  "uniform sampler2D texture;\n"
+  "void main ()\n"
+  "{\n"
+  "  frag_color = texture2D(texture, tex);\n"
+  "}\n";
+
+struct Scene
+{
+  const char* name;
+  glm::mat4 modelview;
+  float size;   //quad half size
+  float tiles;  //texture repeats across the quad
+};
+
+struct Mode
+{
+  const char* name;
+  TextureFilter filter;
+  float anisotropy;
+};
+
+int main(int argc, char** argv)
+{
+  const char* filename = "images/all.bmp";
+  int frames = 30;
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+	frames = atoi(argv[++i]);
+      else
+	filename = argv[i];
+    }
+  if (frames < 1)
+    frames = 1;
+
+  const int width = 1024, height = 1024;
+  if (!csX75::initHeadlessGL(width, height))
+    return -1;
+  csX75::initGL();
+
+  std::vector<GLuint> shaderList;
+  shaderList.push_back(csX75::CreateShaderGL(GL_VERTEX_SHADER, vertex_shader));
+  shaderList.push_back(csX75::CreateShaderGL(GL_FRAGMENT_SHADER, fragment_shader));
+  GLuint shaderProgram = csX75::CreateProgramGL(shaderList);
+  glUseProgram(shaderProgram);
+  GLuint vPosition = glGetAttribLocation(shaderProgram, "vPosition");
+  GLuint texCoord = glGetAttribLocation(shaderProgram, "texCoord");
+  GLuint uModelViewMatrix = glGetUniformLocation(shaderProgram, "uModelViewMatrix");
+
+  Scene scenes[2];
+  scenes[0].name = "tiled quad";
+  scenes[0].modelview = glm::mat4(1.0f);
+  scenes[0].size = 1.0f;
+  scenes[0].tiles = 32.0f;
+  scenes[1].name = "ground plane";
+  scenes[1].modelview = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 1000.0f) *
+    glm::lookAt(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.8f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  scenes[1].size = 500.0f;
+  scenes[1].tiles = 500.0f;
+
+  //One quad per scene, in the xy plane for the first and the xz plane for the second
+  GLuint vao[2], vbo[2];
+  glGenVertexArrays(2, vao);
+  glGenBuffers(2, vbo);
+  for (int i = 0; i < 2; i++)
+    {
+      float s = scenes[i].size, t = scenes[i].tiles;
+      GLfloat quad[] = {
+	-s, -s, 0, 0, 0,   s, -s, 0, t, 0,   s, s, 0, t, t,
+	-s, -s, 0, 0, 0,   s, s, 0, t, t,   -s, s, 0, 0, t
+      };
+      if (i == 1)
+	for (int v = 0; v < 6; v++)
+	  {
+	    quad[5 * v + 2] = quad[5 * v + 1];
+	    quad[5 * v + 1] = 0.0f;
+	  }
+      glBindVertexArray(vao[i]);
+      glBindBuffer(GL_ARRAY_BUFFER, vbo[i]);
+      glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+      glEnableVertexAttribArray(vPosition);
+      glVertexAttribPointer(vPosition, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), BUFFER_OFFSET(0));
+      glEnableVertexAttribArray(texCoord);
+      glVertexAttribPointer(texCoord, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), BUFFER_OFFSET(3 * sizeof(GLfloat)));
+    }
+
+  Mode modes[] = {
+    { "linear",          TEXTURE_LINEAR,     1.0f },
+    { "mipmap",          TEXTURE_MIPMAP,     1.0f },
+    { "mipmap box",      TEXTURE_MIPMAP_BOX, 1.0f },
+    { "mipmap aniso 4",  TEXTURE_MIPMAP,     4.0f },
+    { "mipmap aniso 16", TEXTURE_MIPMAP,     16.0f }
+  };
+  int num_modes = sizeof(modes) / sizeof(modes[0]);
+
+  printf("%s, %dx%d framebuffer\n", glGetString(GL_RENDERER), width, height);
+  printf("%-16s %10s %-13s %10s %12s\n", "mode", "load ms", "scene", "ms/frame", "Msamples/s");
+  for (int m = 0; m < num_modes; m++)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      GLuint tex = LoadTexture(filename, 0, 0, modes[m].filter, modes[m].anisotropy);
+      glFinish();
+      double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      if (tex == 0)
+	return -1;
+
+      for (int i = 0; i < 2; i++)
+	{
+	  glUniformMatrix4fv(uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(scenes[i].modelview));
+	  glBindVertexArray(vao[i]);
+
+	  //Warm up, then time the requested number of frames
+	  for (int f = 0; f < 5; f++)
+	    {
+	      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	      glDrawArrays(GL_TRIANGLES, 0, 6);
+	    }
+	  glFinish();
+	  start = std::chrono::steady_clock::now();
+	  for (int f = 0; f < frames; f++)
+	    {
+	      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	      glDrawArrays(GL_TRIANGLES, 0, 6);
+	    }
+	  glFinish();
+	  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+	  //Every covered pixel takes one filtered sample
+	  GLuint samples = 0;
+	  GLuint query;
+	  glGenQueries(1, &query);
+	  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	  glBeginQuery(GL_SAMPLES_PASSED, query);
+	  glDrawArrays(GL_TRIANGLES, 0, 6);
+	  glEndQuery(GL_SAMPLES_PASSED);
+	  glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+	  glDeleteQueries(1, &query);
+
+	  printf("%-16s %10.2f %-13s %10.3f %12.1f\n", i == 0 ? modes[m].name : "",
+		 load_ms, scenes[i].name, ms, samples / (ms * 1000.0));
+	}
+      FreeTexture(tex);
+    }
+
+  glDeleteBuffers(2, vbo);
+  glDeleteVertexArrays(2, vao);
+  glDeleteProgram(shaderProgram);
+  csX75::terminateHeadlessGL();
+  return 0;
+}
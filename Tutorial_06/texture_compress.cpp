@@ -0,0 +1,463 @@
+#include "gl_framework.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "texture_compress.hpp"
+
+//------------------------------------------------------------------- BC1 / BC3
+
+//RGB565 with rounding, and back to 8 bits by repeating the top bits
+static int pack565( const float c[3] )
+{
+  int r = (int) (c[0] * 31.0f / 255.0f + 0.5f);
+  int g = (int) (c[1] * 63.0f / 255.0f + 0.5f);
+  int b = (int) (c[2] * 31.0f / 255.0f + 0.5f);
+  return (r << 11) | (g << 5) | b;
+}
+
+static void unpack565( int c, int rgb[3] )
+{
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+//Pick the closest of the four colours between c0 and c1 for every texel,
+//returns the squared error
+static int fit_bc1_indices( const unsigned char* rgba, int c0, int c1, int indices[16] )
+{
+  int palette[4][3];
+  unpack565( c0, palette[0] );
+  unpack565( c1, palette[1] );
+  for ( int c = 0; c < 3; c++ )
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+  int error = 0;
+  for ( int i = 0; i < 16; i++ )
+    {
+      const unsigned char* p = rgba + 4 * i;
+      int best = 0, best_error = 1 << 30;
+      for ( int k = 0; k < 4; k++ )
+	{
+	  int dr = p[0] - palette[k][0], dg = p[1] - palette[k][1], db = p[2] - palette[k][2];
+	  int e = dr * dr + dg * dg + db * db;
+	  if ( e < best_error )
+	    {
+	      best_error = e;
+	      best = k;
+	    }
+	}
+      indices[i] = best;
+      error += best_error;
+    }
+  return error;
+}
+
+static void clamp_color( float c[3] )
+{
+  for ( int k = 0; k < 3; k++ )
+    c[k] = c[k] < 0.0f ? 0.0f : (c[k] > 255.0f ? 255.0f : c[k]);
+}
+
+//The colour half of a BC1/BC3 block. The end points start at the extremes of
+//the texels along their principal axis, pulled in by 1/16 of the range, and are
+//then refined by least squares against the chosen indices.
+static void compress_color_block( const unsigned char* rgba, unsigned char* out )
+{
+  float mean[3] = { 0.0f, 0.0f, 0.0f };
+  float lo[3] = { 255.0f, 255.0f, 255.0f }, hi[3] = { 0.0f, 0.0f, 0.0f };
+  for ( int i = 0; i < 16; i++ )
+    for ( int c = 0; c < 3; c++ )
+      {
+	float v = rgba[4 * i + c];
+	mean[c] += v / 16.0f;
+	lo[c] = v < lo[c] ? v : lo[c];
+	hi[c] = v > hi[c] ? v : hi[c];
+      }
+
+  // Covariance, then its main eigenvector by power iteration
+  float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+  for ( int i = 0; i < 16; i++ )
+    {
+      float r = rgba[4 * i] - mean[0], g = rgba[4 * i + 1] - mean[1], b = rgba[4 * i + 2] - mean[2];
+      cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+      cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+  float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+  for ( int iter = 0; iter < 8; iter++ )
+    {
+      float v[3] = {
+	cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+	cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+	cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+      };
+      float length = sqrtf( v[0] * v[0] + v[1] * v[1] + v[2] * v[2] );
+      if ( length < 1e-6f )
+	break;
+      for ( int c = 0; c < 3; c++ )
+	axis[c] = v[c] / length;
+    }
+
+  float min_d = 1e9f, max_d = -1e9f;
+  for ( int i = 0; i < 16; i++ )
+    {
+      float d = 0.0f;
+      for ( int c = 0; c < 3; c++ )
+	d += (rgba[4 * i + c] - mean[c]) * axis[c];
+      min_d = d < min_d ? d : min_d;
+      max_d = d > max_d ? d : max_d;
+    }
+  float inset = (max_d - min_d) / 16.0f;
+  float e0[3], e1[3];
+  for ( int c = 0; c < 3; c++ )
+    {
+      e0[c] = mean[c] + axis[c] * (max_d - inset);
+      e1[c] = mean[c] + axis[c] * (min_d + inset);
+    }
+  clamp_color( e0 );
+  clamp_color( e1 );
+
+  int c0 = pack565( e0 ), c1 = pack565( e1 );
+  int indices[16];
+  int error = fit_bc1_indices( rgba, c0, c1, indices );
+
+  // Least squares end points for the current indices, kept while they help
+  static const float weight0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+  for ( int iter = 0; iter < 2 && error > 0; iter++ )
+    {
+      float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+      for ( int i = 0; i < 16; i++ )
+	{
+	  float a = weight0[indices[i]], b = 1.0f - a;
+	  aa += a * a; ab += a * b; bb += b * b;
+	  for ( int c = 0; c < 3; c++ )
+	    {
+	      ax[c] += a * rgba[4 * i + c];
+	      bx[c] += b * rgba[4 * i + c];
+	    }
+	}
+      float det = aa * bb - ab * ab;
+      if ( fabsf( det ) < 1e-6f )
+	break;
+      for ( int c = 0; c < 3; c++ )
+	{
+	  e0[c] = (bb * ax[c] - ab * bx[c]) / det;
+	  e1[c] = (aa * bx[c] - ab * ax[c]) / det;
+	}
+      clamp_color( e0 );
+      clamp_color( e1 );
+
+      int n0 = pack565( e0 ), n1 = pack565( e1 ), new_indices[16];
+      int new_error = fit_bc1_indices( rgba, n0, n1, new_indices );
+      if ( new_error >= error )
+	break;
+      c0 = n0;
+      c1 = n1;
+      error = new_error;
+      memcpy( indices, new_indices, sizeof(indices) );
+    }
+
+  // Four colour mode needs c0 > c1 - swapping the ends swaps indices 0/1 and 2/3
+  if ( c0 < c1 )
+    {
+      int t = c0; c0 = c1; c1 = t;
+      for ( int i = 0; i < 16; i++ )
+	indices[i] ^= 1;
+    }
+  else if ( c0 == c1 )
+    for ( int i = 0; i < 16; i++ )
+      indices[i] = 0;
+
+  unsigned int bits = 0;
+  for ( int i = 0; i < 16; i++ )
+    bits |= (unsigned int) indices[i] << (2 * i);
+  out[0] = c0 & 0xff; out[1] = c0 >> 8;
+  out[2] = c1 & 0xff; out[3] = c1 >> 8;
+  out[4] = bits & 0xff; out[5] = (bits >> 8) & 0xff;
+  out[6] = (bits >> 16) & 0xff; out[7] = bits >> 24;
+}
+
+void CompressBlockBC1( const unsigned char* rgba, unsigned char* out )
+{
+  compress_color_block( rgba, out );
+}
+
+void CompressBlockBC3( const unsigned char* rgba, unsigned char* out )
+{
+  // Alpha: the block's own min and max with six steps in between
+  int a0 = 0, a1 = 255;
+  for ( int i = 0; i < 16; i++ )
+    {
+      int a = rgba[4 * i + 3];
+      a0 = a > a0 ? a : a0;
+      a1 = a < a1 ? a : a1;
+    }
+  int palette[8] = { a0, a1 };
+  for ( int k = 2; k < 8; k++ )
+    palette[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+
+  unsigned long long bits = 0;
+  if ( a0 > a1 )
+    for ( int i = 0; i < 16; i++ )
+      {
+	int a = rgba[4 * i + 3], best = 0;
+	for ( int k = 1; k < 8; k++ )
+	  if ( abs( a - palette[k] ) < abs( a - palette[best] ) )
+	    best = k;
+	bits |= (unsigned long long) best << (3 * i);
+      }
+  out[0] = a0;
+  out[1] = a1;
+  for ( int k = 0; k < 6; k++ )
+    out[2 + k] = (bits >> (8 * k)) & 0xff;
+
+  compress_color_block( rgba, out + 8 );
+}
+
+//------------------------------------------------------------------- ETC2
+
+//Intensity modifiers for pixel index 0..3, one row per table codeword
+static const int etc_modifiers[8][4] = {
+  { 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+  { 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 }
+};
+
+static int clamp255( int v )
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+//Best table and indices for the 8 texels of a half block around one base colour
+static int fit_etc_subblock( const unsigned char* rgba, const int texels[8], const int base[3],
+			     int* table, int indices[8] )
+{
+  int best_error = 1 << 30;
+  for ( int t = 0; t < 8; t++ )
+    {
+      int error = 0, chosen[8];
+      for ( int i = 0; i < 8 && error < best_error; i++ )
+	{
+	  const unsigned char* p = rgba + 4 * texels[i];
+	  int texel_error = 1 << 30;
+	  for ( int k = 0; k < 4; k++ )
+	    {
+	      int m = etc_modifiers[t][k];
+	      int dr = clamp255( base[0] + m ) - p[0];
+	      int dg = clamp255( base[1] + m ) - p[1];
+	      int db = clamp255( base[2] + m ) - p[2];
+	      int e = dr * dr + dg * dg + db * db;
+	      if ( e < texel_error )
+		{
+		  texel_error = e;
+		  chosen[i] = k;
+		}
+	    }
+	  error += texel_error;
+	}
+      if ( error < best_error )
+	{
+	  best_error = error;
+	  *table = t;
+	  memcpy( indices, chosen, sizeof(chosen) );
+	}
+    }
+  return best_error;
+}
+
+//ETC1 blocks are valid ETC2 RGB8 blocks as long as the differential mode never
+//overflows, so every split (left/right, top/bottom) is tried in individual mode
+//(two 4 bit colours) and, where the colours are close enough, differential mode
+//(a 5 bit colour and a 3 bit offset), and the smallest error wins.
+void CompressBlockETC2( const unsigned char* rgba, unsigned char* out )
+{
+  int best_error = 1 << 30;
+  unsigned char best[8];
+
+  for ( int flip = 0; flip < 2; flip++ )
+    {
+      // Texels of each half, as offsets into rgba (row major)
+      int texels[2][8], n[2] = { 0, 0 };
+      for ( int y = 0; y < 4; y++ )
+	for ( int x = 0; x < 4; x++ )
+	  {
+	    int half = flip ? (y >= 2) : (x >= 2);
+	    texels[half][n[half]++] = y * 4 + x;
+	  }
+
+      float mean[2][3];
+      for ( int h = 0; h < 2; h++ )
+	for ( int c = 0; c < 3; c++ )
+	  {
+	    int sum = 0;
+	    for ( int i = 0; i < 8; i++ )
+	      sum += rgba[4 * texels[h][i] + c];
+	    mean[h][c] = sum / 8.0f;
+	  }
+
+      for ( int diff = 0; diff < 2; diff++ )
+	{
+	  int q[2][3], base[2][3];
+	  bool valid = true;
+	  for ( int h = 0; h < 2; h++ )
+	    for ( int c = 0; c < 3; c++ )
+	      {
+		if ( diff )
+		  {
+		    q[h][c] = (int) (mean[h][c] * 31.0f / 255.0f + 0.5f);
+		    base[h][c] = (q[h][c] << 3) | (q[h][c] >> 2);
+		  }
+		else
+		  {
+		    q[h][c] = (int) (mean[h][c] * 15.0f / 255.0f + 0.5f);
+		    base[h][c] = q[h][c] * 17;
+		  }
+	      }
+	  if ( diff )
+	    for ( int c = 0; c < 3; c++ )
+	      if ( q[1][c] - q[0][c] < -4 || q[1][c] - q[0][c] > 3 )
+		valid = false;
+	  if ( !valid )
+	    continue;
+
+	  int table[2], indices[2][8];
+	  int error = fit_etc_subblock( rgba, texels[0], base[0], &table[0], indices[0] );
+	  if ( error >= best_error )
+	    continue;
+	  error += fit_etc_subblock( rgba, texels[1], base[1], &table[1], indices[1] );
+	  if ( error >= best_error )
+	    continue;
+	  best_error = error;
+
+	  for ( int c = 0; c < 3; c++ )
+	    best[c] = diff ? (q[0][c] << 3) | ((q[1][c] - q[0][c]) & 7) : (q[0][c] << 4) | q[1][c];
+	  best[3] = (table[0] << 5) | (table[1] << 2) | (diff << 1) | flip;
+
+	  // Index bits go column by column: texel (x, y) is bit x*4+y
+	  unsigned int bits = 0;
+	  for ( int h = 0; h < 2; h++ )
+	    for ( int i = 0; i < 8; i++ )
+	      {
+		int x = texels[h][i] % 4, y = texels[h][i] / 4, k = x * 4 + y;
+		bits |= (unsigned int) (indices[h][i] >> 1) << (16 + k);
+		bits |= (unsigned int) (indices[h][i] & 1) << k;
+	      }
+	  best[4] = bits >> 24; best[5] = (bits >> 16) & 0xff;
+	  best[6] = (bits >> 8) & 0xff; best[7] = bits & 0xff;
+	}
+    }
+  memcpy( out, best, 8 );
+}
+
+//------------------------------------------------------------------- Images
+
+unsigned int CompressedGLFormat( CompressedFormat format )
+{
+  switch ( format )
+    {
+    case COMPRESS_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case COMPRESS_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case COMPRESS_ETC2: return GL_COMPRESSED_RGB8_ETC2;
+    }
+  return 0;
+}
+
+size_t CompressedSize( CompressedFormat format, int width, int height )
+{
+  size_t blocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+  return blocks * (format == COMPRESS_BC3 ? 16 : 8);
+}
+
+void CompressImage( CompressedFormat format, const unsigned char* pixels, int width, int height,
+		    int stride, int bytes_per_pixel, std::vector<unsigned char>& out )
+{
+  int block_size = format == COMPRESS_BC3 ? 16 : 8;
+  out.resize( CompressedSize( format, width, height ) );
+  unsigned char* dst = out.data();
+
+  unsigned char rgba[64];
+  for ( int by = 0; by < height; by += 4 )
+    for ( int bx = 0; bx < width; bx += 4, dst += block_size )
+      {
+	for ( int y = 0; y < 4; y++ )
+	  for ( int x = 0; x < 4; x++ )
+	    {
+	      int sx = bx + x < width ? bx + x : width - 1;
+	      int sy = by + y < height ? by + y : height - 1;
+	      const unsigned char* src = pixels + (size_t) sy * stride + sx * bytes_per_pixel;
+	      unsigned char* texel = rgba + 4 * (y * 4 + x);
+	      texel[0] = src[2];
+	      texel[1] = src[1];
+	      texel[2] = src[0];
+	      texel[3] = bytes_per_pixel == 4 ? src[3] : 255;
+	    }
+	switch ( format )
+	  {
+	  case COMPRESS_BC1: CompressBlockBC1( rgba, dst ); break;
+	  case COMPRESS_BC3: CompressBlockBC3( rgba, dst ); break;
+	  case COMPRESS_ETC2: CompressBlockETC2( rgba, dst ); break;
+	  }
+      }
+}
+
+//------------------------------------------------------------------- KTX
+
+static void write_u32( FILE* file, unsigned int v )
+{
+  fwrite( &v, 4, 1, file ); // KTX files are written in the writer's byte order
+}
+
+bool WriteKTX( const char* filename, CompressedFormat format, int width, int height,
+	       const std::vector< std::vector<unsigned char> >& levels )
+{
+  static const unsigned char identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+  };
+  static const char orientation[] = "KTXorientation\0S=r,T=u";
+
+  FILE* file = fopen( filename, "wb" );
+  if ( file == NULL )
+    {
+      printf("Cannot write %s\n", filename);
+      return false;
+    }
+
+  fwrite( identifier, sizeof(identifier), 1, file );
+  write_u32( file, 0x04030201 );                       // endianness
+  write_u32( file, 0 );                                // glType, 0 when compressed
+  write_u32( file, 1 );                                // glTypeSize
+  write_u32( file, 0 );                                // glFormat, 0 when compressed
+  write_u32( file, CompressedGLFormat( format ) );     // glInternalFormat
+  write_u32( file, format == COMPRESS_BC3 ? GL_RGBA : GL_RGB );
+  write_u32( file, width );
+  write_u32( file, height );
+  write_u32( file, 0 );                                // pixelDepth
+  write_u32( file, 0 );                                // numberOfArrayElements
+  write_u32( file, 1 );                                // numberOfFaces
+  write_u32( file, (unsigned int) levels.size() );
+
+  // One key/value pair saying the first row is the bottom one, padded to 4 bytes
+  unsigned int pair_size = sizeof(orientation);
+  unsigned int padded_size = (pair_size + 3) & ~3u;
+  const unsigned char padding[4] = { 0, 0, 0, 0 };
+  write_u32( file, 4 + padded_size );
+  write_u32( file, pair_size );
+  fwrite( orientation, pair_size, 1, file );
+  fwrite( padding, padded_size - pair_size, 1, file );
+
+  for ( size_t i = 0; i < levels.size(); i++ )
+    {
+      write_u32( file, (unsigned int) levels[i].size() );
+      fwrite( levels[i].data(), 1, levels[i].size(), file ); // blocks are 8 or 16 bytes, no padding needed
+    }
+
+  bool ok = !ferror( file );
+  ok = fclose( file ) == 0 && ok;
+  if ( !ok )
+    printf("Cannot write %s\n", filename);
+  return ok;
+}
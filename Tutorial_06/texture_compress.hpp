@@ -0,0 +1,37 @@
+#ifndef _TEXTURE_COMPRESS_HPP_
+#define _TEXTURE_COMPRESS_HPP_
+
+#include <cstddef>
+#include <vector>
+
+//! Block compressed formats the offline compressor writes. All of them store
+//! 4x4 texel blocks - BC1 and ETC2 in 8 bytes (4 bits a texel), BC3 in 16.
+enum CompressedFormat
+{
+  COMPRESS_BC1,   //!< S3TC DXT1, RGB
+  COMPRESS_BC3,   //!< S3TC DXT5, RGB plus a separate alpha block
+  COMPRESS_ETC2   //!< ETC2 RGB8, only the ETC1 compatible modes are used
+};
+
+//! One 4x4 block. rgba holds 16 texels row by row, 4 bytes each
+void CompressBlockBC1( const unsigned char* rgba, unsigned char* out );
+void CompressBlockBC3( const unsigned char* rgba, unsigned char* out );
+void CompressBlockETC2( const unsigned char* rgba, unsigned char* out );
+
+//! Compress a whole image given as BGR or BGRA rows, stride bytes apart,
+//! in the order they are stored (for GL the bottom row first). Sizes that
+//! are not a multiple of 4 repeat the last row and column.
+void CompressImage( CompressedFormat format, const unsigned char* pixels, int width, int height,
+		    int stride, int bytes_per_pixel, std::vector<unsigned char>& out );
+
+//! GL internal format of the compressed data
+unsigned int CompressedGLFormat( CompressedFormat format );
+//! Bytes for one level of the given size
+size_t CompressedSize( CompressedFormat format, int width, int height );
+
+//! Write a KTX 1.1 file with one compressed image per mip level, largest first,
+//! rows bottom first as GL expects (recorded as KTXorientation S=r,T=u)
+bool WriteKTX( const char* filename, CompressedFormat format, int width, int height,
+	       const std::vector< std::vector<unsigned char> >& levels );
+
+#endif
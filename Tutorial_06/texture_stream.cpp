@@ -0,0 +1,232 @@
+#include "texture_stream.hpp"
+
+#include <chrono>
+#include <cstring>
+
+namespace csX75
+{
+  TextureStreamer::TextureStreamer(int num_threads)
+    : in_flight(0), stopping(false), upload_head(0)
+  {
+    //!Mid grey stands in for every texture that is still loading
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    placeholder = CreateTexture(1, 1, 4, TEXTURE_LINEAR, 1.0f);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_BGRA, GL_UNSIGNED_BYTE, grey);
+
+    glGenBuffers(UPLOAD_RING_SIZE, upload_pbo);
+    for (int i = 0; i < UPLOAD_RING_SIZE; i++)
+      upload_fence[i] = NULL;
+
+    if (num_threads <= 0)
+      num_threads = (int) std::thread::hardware_concurrency() - 1;
+    if (num_threads < 1)
+      num_threads = 1;
+    for (int i = 0; i < num_threads; i++)
+      workers.push_back(std::thread(&TextureStreamer::worker_loop, this));
+  }
+
+  TextureStreamer::~TextureStreamer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(job_mutex);
+      stopping = true;
+    }
+    job_cv.notify_all();
+    for (std::size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+
+    //!Whatever was still queued or decoded is thrown away
+    for (std::size_t i = 0; i < queued_jobs.size(); i++)
+      delete queued_jobs[i];
+    for (std::size_t i = 0; i < decoded_jobs.size(); i++)
+      {
+	UnmapBMP(decoded_jobs[i]->image);
+	delete decoded_jobs[i];
+      }
+
+    for (int i = 0; i < UPLOAD_RING_SIZE; i++)
+      if (upload_fence[i] != NULL)
+	glDeleteSync(upload_fence[i]);
+    glDeleteBuffers(UPLOAD_RING_SIZE, upload_pbo);
+    for (std::size_t i = 0; i < textures.size(); i++)
+      if (textures[i] != placeholder)
+	glDeleteTextures(1, &textures[i]);
+    glDeleteTextures(1, &placeholder);
+  }
+
+  int TextureStreamer::request(const char* filename, TextureFilter filter, float max_anisotropy)
+  {
+    TextureJob* job = new TextureJob;
+    job->handle = (int) textures.size();
+    job->filename = filename;
+    job->filter = filter;
+    job->max_anisotropy = max_anisotropy;
+    job->ok = false;
+    textures.push_back(placeholder);
+
+    {
+      std::lock_guard<std::mutex> lock(job_mutex);
+      queued_jobs.push_back(job);
+      in_flight++;
+    }
+    job_cv.notify_one();
+    return job->handle;
+  }
+
+  void TextureStreamer::worker_loop(void)
+  {
+    for (;;)
+      {
+	TextureJob* job;
+	{
+	  std::unique_lock<std::mutex> lock(job_mutex);
+	  while (!stopping && queued_jobs.empty())
+	    job_cv.wait(lock);
+	  if (stopping)
+	    return;
+	  job = queued_jobs.front();
+	  queued_jobs.pop_front();
+	}
+
+	job->ok = MapBMP(job->filename.c_str(), job->image);
+	if (job->ok)
+	  {
+	    //!Fault the pixels in here, so the copy on the GL thread never waits for the disk
+	    const unsigned char* pixels = job->image.pixels;
+	    size_t size = (size_t) job->image.stride * job->image.height;
+	    volatile unsigned char touch = 0;
+	    for (size_t i = 0; i < size; i += 4096)
+	      touch += pixels[i];
+	    (void) touch;
+
+	    if (job->filter == TEXTURE_MIPMAP_BOX)
+	      BuildBoxMipmaps(job->image, job->mip_chain);
+	  }
+
+	std::lock_guard<std::mutex> lock(job_mutex);
+	decoded_jobs.push_back(job);
+      }
+  }
+
+  void TextureStreamer::upload(TextureJob* job, int slot)
+  {
+    const BMPImage& image = job->image;
+    size_t level0_size = (size_t) image.stride * image.height;
+    size_t size = level0_size + job->mip_chain.size();
+
+    //!Orphan the old contents so the driver never waits on the previous upload from this slot
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_pbo[slot]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    unsigned char* staging = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+							       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (staging == NULL)
+      {
+	std::cerr<<"Cannot map the upload buffer for "<<job->filename<<std::endl;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return;
+      }
+
+    //!Rows keep their 4 byte padding, a top-down image is put bottom row first on the way
+    if (!image.top_down)
+      memcpy(staging, image.pixels, level0_size);
+    else
+      for (int y = 0; y < image.height; y++)
+	memcpy(staging + (size_t) y * image.stride,
+	       image.pixels + (size_t) (image.height - 1 - y) * image.stride, image.stride);
+    if (!job->mip_chain.empty())
+      memcpy(staging + level0_size, job->mip_chain.data(), job->mip_chain.size());
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    //!With an unpack buffer bound the pixel pointers are offsets into it
+    GLenum format = image.bytes_per_pixel == 4 ? GL_BGRA : GL_BGR;
+    GLuint texture = CreateTexture(image.width, image.height, image.bytes_per_pixel,
+				   job->filter, job->max_anisotropy);
+    GLint old_alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &old_alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, BUFFER_OFFSET(0));
+
+    if (job->filter == TEXTURE_MIPMAP)
+      glGenerateMipmap(GL_TEXTURE_2D);
+    else if (job->filter == TEXTURE_MIPMAP_BOX)
+      {
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	size_t offset = level0_size;
+	int levels = MipLevels(image.width, image.height);
+	for (int level = 1, w = image.width, h = image.height; level < levels; level++)
+	  {
+	    w = w > 1 ? w / 2 : 1;
+	    h = h > 1 ? h / 2 : 1;
+	    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, w, h, format, GL_UNSIGNED_BYTE, BUFFER_OFFSET(offset));
+	    offset += (size_t) w * h * image.bytes_per_pixel;
+	  }
+      }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, old_alignment);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    textures[job->handle] = texture;
+  }
+
+  int TextureStreamer::update(size_t max_bytes)
+  {
+    int uploaded = 0;
+    size_t bytes = 0;
+    for (;;)
+      {
+	TextureJob* job;
+	{
+	  std::lock_guard<std::mutex> lock(job_mutex);
+	  if (decoded_jobs.empty())
+	    break;
+	  job = decoded_jobs.front();
+
+	  size_t size = (size_t) job->image.stride * job->image.height + job->mip_chain.size();
+	  if (job->ok && bytes > 0 && bytes + size > max_bytes)
+	    break;
+	  //!Every buffer in the ring is still being read by GL - try again next frame
+	  int slot = upload_head;
+	  if (job->ok && upload_fence[slot] != NULL &&
+	      glClientWaitSync(upload_fence[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+	    break;
+	  decoded_jobs.pop_front();
+	  bytes += size;
+	}
+
+	if (job->ok)
+	  {
+	    int slot = upload_head;
+	    if (upload_fence[slot] != NULL)
+	      glDeleteSync(upload_fence[slot]);
+	    upload(job, slot);
+	    upload_fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	    upload_head = (upload_head + 1) % UPLOAD_RING_SIZE;
+	    UnmapBMP(job->image);
+	    if (resident(job->handle))
+	      uploaded++;
+	  }
+	delete job;
+
+	std::lock_guard<std::mutex> lock(job_mutex);
+	in_flight--;
+      }
+    return uploaded;
+  }
+
+  void TextureStreamer::finish(void)
+  {
+    while (pending() > 0)
+      {
+	if (update((size_t) -1) == 0)
+	  {
+	    glFlush();
+	    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	  }
+      }
+  }
+
+  int TextureStreamer::pending(void)
+  {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    return in_flight;
+  }
+};
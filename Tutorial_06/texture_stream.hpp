@@ -0,0 +1,78 @@
+#ifndef _TEXTURE_STREAM_HPP_
+#define _TEXTURE_STREAM_HPP_
+
+#include "gl_framework.hpp"
+#include "texture.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Number of pixel unpack buffers that uploads rotate through
+#define UPLOAD_RING_SIZE 3
+
+namespace csX75
+{
+  //! One texture on its way in: a worker maps and filters it, the GL thread uploads it
+  struct TextureJob
+  {
+    int handle;
+    std::string filename;
+    TextureFilter filter;
+    float max_anisotropy;
+    bool ok;
+    BMPImage image;
+    std::vector<unsigned char> mip_chain;
+  };
+
+  //! Loads textures in the background so the first frame does not wait for them.
+  //! request() returns at once with a handle whose texture() is a 1x1 placeholder;
+  //! worker threads map, validate and (for TEXTURE_MIPMAP_BOX) filter the image,
+  //! and update(), called by the GL thread every frame, copies finished images into
+  //! a ring of pixel unpack buffers and creates the real texture from them, so the
+  //! upload itself does not block the frame.
+  class TextureStreamer
+  {
+    std::vector<GLuint> textures;
+    GLuint placeholder;
+
+    std::deque<TextureJob*> queued_jobs;
+    std::deque<TextureJob*> decoded_jobs;
+    int in_flight;
+    std::mutex job_mutex;
+    std::condition_variable job_cv;
+    std::vector<std::thread> workers;
+    bool stopping;
+
+    GLuint upload_pbo[UPLOAD_RING_SIZE];
+    GLsync upload_fence[UPLOAD_RING_SIZE];
+    int upload_head;
+
+    void worker_loop(void);
+    void upload(TextureJob* job, int slot);
+
+  public:
+    //! Needs a current GL context. num_threads <= 0 picks one less than the number of cores
+    TextureStreamer(int num_threads);
+    ~TextureStreamer();
+
+    //! Start loading a BMP, the handle is valid right away
+    int request(const char* filename, TextureFilter filter = TEXTURE_LINEAR, float max_anisotropy = 1.0f);
+    //! Upload finished images, at most max_bytes of them (but always at least one) per call.
+    //! Returns how many textures became resident.
+    int update(size_t max_bytes = 8 << 20);
+    //! Block until every requested texture is resident
+    void finish(void);
+
+    //! The texture to bind for a handle - the placeholder until it is resident
+    GLuint texture(int handle) const { return textures[handle]; }
+    bool resident(int handle) const { return textures[handle] != placeholder; }
+    //! Requests not yet resident
+    int pending(void);
+  };
+};
+
+#endif
@@ -6,6 +6,10 @@
 
   Use the keys 1,2 and 3 to switch between arms.
 
+  Run with --stats to print how many uniform uploads were skipped
+  how many meshes were uploaded, and with instancing how many
+  instanced draws there were, on exit.
+
   Modified from An Introduction to OpenGL Programming, 
   Ed Angel and Dave Shreiner, SIGGRAPH 2013
 
@@ -16,7 +20,11 @@
 
 #include "07_hierarchical_modelling.hpp"
 
-GLuint shaderProgram;
+csX75::Program* shaderProgram;
+csX75::Program* instancedProgram;
+csX75::InstancedRenderer* instancer;
+//Print the counters of the program, meshes and instancing on exit
+bool show_stats=false;
 
 glm::mat4 rotation_matrix;
 glm::mat4 projection_matrix;
@@ -29,8 +37,8 @@ glm::mat4 view_matrix;
 
 glm::mat4 modelview_matrix;
 
-GLuint uModelViewMatrix;
-const int num_vertices = 36;
+const int num_vertices = 8;
+const int num_indices = 36;
 
 
 //-----------------------------------------------------------------
@@ -61,21 +69,18 @@ glm::vec4 colors[8] = {
 };
 
 int tri_idx=0;
+GLuint v_indices[num_indices];
 glm::vec4 v_positions[num_vertices];
 glm::vec4 v_colors[num_vertices];
 
-// quad generates two triangles for each face and assigns colors to the vertices
+// quad generates two triangles for each face, as indices of its corners
 void quad(int a, int b, int c, int d)
 {
-  v_colors[tri_idx] = colors[a]; v_positions[tri_idx] = positions[a]; tri_idx++;
-  v_colors[tri_idx] = colors[b]; v_positions[tri_idx] = positions[b]; tri_idx++;
-  v_colors[tri_idx] = colors[c]; v_positions[tri_idx] = positions[c]; tri_idx++;
-  v_colors[tri_idx] = colors[a]; v_positions[tri_idx] = positions[a]; tri_idx++;
-  v_colors[tri_idx] = colors[c]; v_positions[tri_idx] = positions[c]; tri_idx++;
-  v_colors[tri_idx] = colors[d]; v_positions[tri_idx] = positions[d]; tri_idx++;
+  v_indices[tri_idx++] = a; v_indices[tri_idx++] = b; v_indices[tri_idx++] = c;
+  v_indices[tri_idx++] = a; v_indices[tri_idx++] = c; v_indices[tri_idx++] = d;
  }
 
-// generate 12 triangles: 36 vertices and 36 colors
+// generate 12 triangles: 36 indices into 8 vertices and 8 colors
 void colorcube(void)
 {
     quad( 1, 0, 3, 2 );
@@ -84,6 +89,19 @@ void colorcube(void)
     quad( 6, 5, 1, 2 );
     quad( 4, 5, 6, 7 );
     quad( 5, 4, 0, 1 );
+
+    // Every corner is shaded once for the triangles around it while it is in
+    // the vertex cache. Order the triangles to keep it there, and the corners
+    // in the order the triangles first use them
+    std::vector<GLuint> indices(v_indices, v_indices + num_indices);
+    csX75::OptimizeVertexCache(indices, num_vertices);
+    std::vector<GLuint> remap = csX75::OptimizeVertexFetch(indices, num_vertices);
+    std::copy(indices.begin(), indices.end(), v_indices);
+    for (int v = 0; v < num_vertices; v++)
+      {
+        v_positions[remap[v]] = positions[v];
+        v_colors[remap[v]] = colors[v];
+      }
 }
 
 
@@ -96,17 +114,21 @@ void initBuffersGL(void)
   std::string vertex_shader_file("07_vshader.glsl");
   std::string fragment_shader_file("07_fshader.glsl");
 
-  std::vector<GLuint> shaderList;
-  shaderList.push_back(csX75::LoadShaderGL(GL_VERTEX_SHADER, vertex_shader_file));
-  shaderList.push_back(csX75::LoadShaderGL(GL_FRAGMENT_SHADER, fragment_shader_file));
+  std::vector< std::vector<GLuint> > shaderLists(2);
+  shaderLists[0].push_back(csX75::LoadShaderGL(GL_VERTEX_SHADER, vertex_shader_file));
+  shaderLists[0].push_back(csX75::LoadShaderGL(GL_FRAGMENT_SHADER, fragment_shader_file));
+  // The same fragment shader, with the model matrix an attribute read per instance
+  shaderLists[1].push_back(csX75::LoadShaderGL(GL_VERTEX_SHADER, std::string("07_vshader_instanced.glsl")));
+  shaderLists[1].push_back(csX75::LoadShaderGL(GL_FRAGMENT_SHADER, fragment_shader_file));
 
-  shaderProgram = csX75::CreateProgramGL(shaderList);
-  glUseProgram( shaderProgram );
+  // Both programs are compiled and linked together. Each looks up its
+  // attributes and uniforms itself, the nodes ask it for theirs
+  std::vector<csX75::Program*> programs = csX75::Program::CreateAll(shaderLists);
+  shaderProgram = programs[0];
+  instancedProgram = programs[1];
+  shaderProgram->use();
 
-  // getting the attributes from the shader program
-  vPosition = glGetAttribLocation( shaderProgram, "vPosition" );
-  vColor = glGetAttribLocation( shaderProgram, "vColor" ); 
-  uModelViewMatrix = glGetUniformLocation( shaderProgram, "uModelViewMatrix");
+  instancer = new csX75::InstancedRenderer(instancedProgram);
 
   // Creating the hierarchy:
   // We are using the original colorcube function to generate the vertices of the cuboid
@@ -114,14 +136,17 @@ void initBuffersGL(void)
 
   //note that the buffers are initialized in the respective constructors
  
-  node1 = new csX75::HNode(NULL,num_vertices,v_positions,v_colors,sizeof(v_positions),sizeof(v_colors));
-  node2 = new csX75::HNode(node1,num_vertices,v_positions,v_colors,sizeof(v_positions),sizeof(v_colors));
+  node1 = new csX75::HNode(NULL,num_vertices,v_positions,v_colors,sizeof(v_positions),sizeof(v_colors),shaderProgram,v_indices,num_indices);
+  node2 = new csX75::HNode(node1,num_vertices,v_positions,v_colors,sizeof(v_positions),sizeof(v_colors),shaderProgram,v_indices,num_indices);
   node2->change_parameters(2.0,0.0,0.0,0.0,0.0,0.0);
-  node3 = new csX75::HNode(node2,num_vertices,v_positions,v_colors,sizeof(v_positions),sizeof(v_colors));
+  node3 = new csX75::HNode(node2,num_vertices,v_positions,v_colors,sizeof(v_positions),sizeof(v_colors),shaderProgram,v_indices,num_indices);
   node3->change_parameters(2.0,0.0,0.0,0.0,0.0,0.0);
   root_node = node1;
   curr_node = node3;
 
+  //room for the camera and one entry per level of the tree
+  matrixStack.reserve(4);
+
 }
 
 void renderGL(void)
@@ -149,14 +174,57 @@ void renderGL(void)
 
   view_matrix = projection_matrix*lookat_matrix;
 
-  matrixStack.push_back(view_matrix);
+  csX75::push_matrix(view_matrix);
+
+  if(enable_instancing)
+    node1->render_tree(*instancer);
+  else
+    {
+      shaderProgram->use();
+      node1->render_tree();
+    }
 
-  node1->render_tree();
+}
 
+//Print how many uniform uploads the program skipped, how many meshes the
+//nodes share and how many instanced draws there were, when run with --stats
+void printStats(void)
+{
+  std::cout<<"Uniform uploads: "<<shaderProgram->uploads<<", skipped as unchanged: "
+	   <<shaderProgram->skipped<<std::endl;
+  std::cout<<"Meshes: "<<csX75::meshes.uploads<<" uploaded for "<<csX75::meshes.requests
+	   <<" nodes, "<<csX75::meshes.bytes()<<" bytes"<<std::endl;
+  if (enable_instancing)
+    std::cout<<"Instanced draws: "<<instancer->draws<<" for "<<instancer->instances<<" nodes"<<std::endl;
 }
 
 int main(int argc, char** argv)
 {
+  //! Render offscreen without a window when asked to (--headless or CSX75_HEADLESS=1)
+  bool headless = csX75::parse_headless_args(argc, argv);
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--instanced") == 0)
+	enable_instancing = true;
+      else if (strcmp(argv[i], "--stats") == 0)
+	show_stats = true;
+    }
+  if (headless)
+    {
+      if (!csX75::initHeadlessGL(512, 512))
+	return -1;
+      csX75::initGL();
+      initBuffersGL();
+      csX75::runHeadlessGL(renderGL);
+      if (show_stats)
+	printStats();
+      delete instancer;
+      delete instancedProgram;
+      delete shaderProgram;
+      csX75::terminateHeadlessGL();
+      return 0;
+    }
+
   //! The pointer to the GLFW window
   GLFWwindow* window;
 
@@ -228,6 +296,11 @@ int main(int argc, char** argv)
       glfwPollEvents();
     }
   
+  if (show_stats)
+    printStats();
+  delete instancer;
+  delete instancedProgram;
+  delete shaderProgram;
   glfwTerminate();
   return 0;
 }
@@ -26,6 +26,7 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "hierarchy_node.hpp"
+#include "mesh_optimize.hpp"
 
 /*// Translation Parameters
 GLfloat xpos=0.0,ypos=0.0,zpos=0.0;
@@ -42,8 +43,8 @@ bool enable_culling=true;
 bool solid=true;
 //Enable/Disable perspective view
 bool enable_perspective=false;
-//Shader program attribs
-GLuint vPosition,vColor;
+//Draw each mesh once for all the nodes using it
+bool enable_instancing=false;
 
 //global matrix stack for hierarchical modelling
 std::vector<glm::mat4> matrixStack;
@@ -3,10 +3,11 @@
 in vec4 vPosition;
 in vec4 vColor;
 out vec4 color;
-uniform mat4 uModelViewMatrix;
+uniform mat4 uViewMatrix;
+uniform mat4 uModelMatrix;
 
 void main (void) 
 {
-  gl_Position = uModelViewMatrix * vPosition;
+  gl_Position = uViewMatrix * uModelMatrix * vPosition;
   color = vColor;
 }
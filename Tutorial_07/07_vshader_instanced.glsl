@@ -0,0 +1,13 @@
+#version 130
+
+in vec4 vPosition;
+in vec4 vColor;
+in mat4 vModelMatrix;
+out vec4 color;
+uniform mat4 uViewMatrix;
+
+void main (void) 
+{
+  gl_Position = uViewMatrix * vModelMatrix * vPosition;
+  color = vColor;
+}
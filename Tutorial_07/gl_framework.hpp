@@ -20,6 +20,17 @@ namespace csX75
   void framebuffer_size_callback(GLFWwindow* window, int width, int height);
   //!GLFW keyboard callback
   void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+  //! Headless mode - strips --headless and --frames N from argv, also honours CSX75_HEADLESS
+  bool parse_headless_args(int &argc, char** argv);
+  //! Create a windowless EGL context that renders into an offscreen framebuffer
+  bool initHeadlessGL(int width, int height);
+  //! Render the requested number of frames into the offscreen framebuffer
+  void runHeadlessGL(void (*render)(void));
+  //! Release the offscreen framebuffer and the EGL context
+  void terminateHeadlessGL(void);
+  //! Size of the offscreen framebuffer
+  void get_headless_size(int* width, int* height);
 };
 
 #endif
@@ -2,155 +2,143 @@
 
 #include <iostream>
 
-extern GLuint vPosition,vColor,uModelViewMatrix;
 extern std::vector<glm::mat4> matrixStack;
 
 namespace csX75
 {
+	SceneGraph hierarchy;
 
-	HNode::HNode(HNode* a_parent, GLuint num_v, glm::vec4* a_vertices, glm::vec4* a_colours, std::size_t v_size, std::size_t c_size){
+	//the HNode of each scene graph node, to draw a subtree in slot order
+	static std::vector<HNode*> hnodes;
 
-		num_vertices = num_v;
-		vertex_buffer_size = v_size;
-		color_buffer_size = c_size;
-		// initialize vao and vbo of the object;
+	HNode::HNode(HNode* a_parent, GLuint num_v, glm::vec4* a_vertices, glm::vec4* a_colours, std::size_t v_size, std::size_t c_size, Program* a_program, const GLuint* a_indices, GLsizei num_i){
 
+		// the vao and vbo are only made for vertices no other node has uploaded
+		mesh = meshes.acquire(num_v, a_vertices, a_colours, v_size, c_size, a_program, a_indices, num_i);
+		init(a_parent, a_program);
+	}
 
-		//Ask GL for a Vertex Attribute Objects (vao)
-		glGenVertexArrays (1, &vao);
-		//Ask GL for aVertex Buffer Object (vbo)
-		glGenBuffers (1, &vbo);
-
-		//bind them
-		glBindVertexArray (vao);
-		glBindBuffer (GL_ARRAY_BUFFER, vbo);
-
-		
-		glBufferData (GL_ARRAY_BUFFER, vertex_buffer_size + color_buffer_size, NULL, GL_STATIC_DRAW);
-		glBufferSubData( GL_ARRAY_BUFFER, 0, vertex_buffer_size, a_vertices );
-		glBufferSubData( GL_ARRAY_BUFFER, vertex_buffer_size, color_buffer_size, a_colours );
-
-		//setup the vertex array as per the shader
-		glEnableVertexAttribArray( vPosition );
-		glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-
-		glEnableVertexAttribArray( vColor );
-		glVertexAttribPointer( vColor, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vertex_buffer_size));
-
-
-		// set parent
-
-		if(a_parent == NULL){
-			parent = NULL;
-		}
-		else{
-			parent = a_parent;
-			parent->add_child(this);
-		}
-
-		//initial parameters are set to 0;
+	HNode::HNode(HNode* a_parent, Mesh* a_mesh, Program* a_program){
 
-		tx=ty=tz=rx=ry=rz=0;
+		mesh = meshes.acquire(a_mesh);
+		init(a_parent, a_program);
+	}
 
-		update_matrices();
+	HNode::~HNode(){
+		meshes.release(mesh);
+		hnodes[node] = NULL;
 	}
 
-	void HNode::update_matrices(){
+	void HNode::init(HNode* a_parent, Program* a_program){
 
-		rotation = glm::rotate(glm::mat4(1.0f), glm::radians(rx), glm::vec3(1.0f,0.0f,0.0f));
-		rotation = glm::rotate(rotation, glm::radians(ry), glm::vec3(0.0f,1.0f,0.0f));
-		rotation = glm::rotate(rotation, glm::radians(rz), glm::vec3(0.0f,0.0f,1.0f));
+		program = a_program;
+		uModelMatrix = program->uniform("uModelMatrix");
+		uViewMatrix = program->uniform("uViewMatrix");
 
-		translation = glm::translate(glm::mat4(1.0f),glm::vec3(tx,ty,tz));
+		// set parent, the scene graph keeps the tree
 
+		node = hierarchy.add_node(a_parent == NULL ? -1 : a_parent->node);
+		if(node >= (int) hnodes.size())
+			hnodes.resize(node + 1);
+		hnodes[node] = this;
 
+		//initial parameters are 0, as for every new scene graph node
 	}
 
 	void HNode::add_child(HNode* a_child){
-		children.push_back(a_child);
-
+		hierarchy.set_parent(a_child->node, node);
 	}
 
 	void HNode::change_parameters(GLfloat atx, GLfloat aty, GLfloat atz, GLfloat arx, GLfloat ary, GLfloat arz){
-		tx = atx;
-		ty = aty;
-		tz = atz;
-		rx = arx;
-		ry = ary;
-		rz = arz;
+		hierarchy.set_transform(node, glm::vec3(atx,aty,atz), glm::vec3(arx,ary,arz));
+	}
 
-		update_matrices();
+	void HNode::rotate(const glm::vec3& by){
+		hierarchy.set_transform(node, hierarchy.translation(node), hierarchy.rotation(node) + by);
 	}
 
 	void HNode::render(){
 
-		//matrixStack multiply
-		glm::mat4* ms_mult = multiply_stack(matrixStack);
-
-		glUniformMatrix4fv(uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(*ms_mult));
-		glBindVertexArray (vao);
-		glDrawArrays(GL_TRIANGLES, 0, num_vertices);
-
-		// for memory 
-		delete ms_mult;
+		//the top of the matrix stack is the same for the whole tree, so it is
+		//only sent once, and a node that has not moved is not sent either
+		program->set(uViewMatrix, matrixStack.back());
+		program->set(uModelMatrix, hierarchy.world(node));
+		glBindVertexArray (mesh->vao);
+		if(mesh->ibo != 0)
+			glDrawElements(GL_TRIANGLES, mesh->count, mesh->index_type, BUFFER_OFFSET(0));
+		else
+			glDrawArrays(GL_TRIANGLES, mesh->first, mesh->count);
 
 	}
 
 	void HNode::render_tree(){
-		
-		matrixStack.push_back(translation);
-		matrixStack.push_back(rotation);
 
-		render();
-		for(int i=0;i<children.size();i++){
-			children[i]->render_tree();
+		//one pass over the flat arrays brings every moved world matrix up to date
+		hierarchy.update();
+
+		//the subtree is a run of slots, parents before children
+		int first = hierarchy.slot(node);
+		int last = first + hierarchy.subtree_size(node);
+		for(int i=first;i<last;i++){
+			HNode* n = hnodes[hierarchy.node_at(i)];
+			if(n != NULL)
+				n->render();
 		}
-		matrixStack.pop_back();
-		matrixStack.pop_back();
+	}
+
+	void HNode::render_tree(InstancedRenderer& instancer){
+
+		hierarchy.update();
 
+		//the world matrices go to the instancer, which draws each mesh once
+		//with all the copies of it in the tree
+		int first = hierarchy.slot(node);
+		int last = first + hierarchy.subtree_size(node);
+		for(int i=first;i<last;i++){
+			HNode* n = hnodes[hierarchy.node_at(i)];
+			if(n != NULL)
+				instancer.add(n->mesh, hierarchy.world(n->node));
+		}
+		instancer.flush(matrixStack.back());
 	}
 
 	void HNode::inc_rx(){
-		rx++;
-		update_matrices();
+		rotate(glm::vec3(1.0f,0.0f,0.0f));
 	}
 
 
 	void HNode::inc_ry(){
-		ry++;
-		update_matrices();
+		rotate(glm::vec3(0.0f,1.0f,0.0f));
 	}
 
 	void HNode::inc_rz(){
-		rz++;
-		update_matrices();
+		rotate(glm::vec3(0.0f,0.0f,1.0f));
 	}
 
 	void HNode::dec_rx(){
-		rx--;
-		update_matrices();
+		rotate(glm::vec3(-1.0f,0.0f,0.0f));
 	}
 
 	void HNode::dec_ry(){
-		ry--;
-		update_matrices();
+		rotate(glm::vec3(0.0f,-1.0f,0.0f));
 	}
 
 	void HNode::dec_rz(){
-		rz--;
-		update_matrices();
+		rotate(glm::vec3(0.0f,0.0f,-1.0f));
 	}
 
 
-	glm::mat4* multiply_stack(std::vector<glm::mat4> matStack){
-		glm::mat4* mult;
-		mult = new glm::mat4(1.0f);
-	
-		for(int i=0;i<matStack.size();i++){
-			*mult = (*mult) * matStack[i];
-		}	
+	void push_matrix(const glm::mat4& m){
+		//the vector keeps its capacity when popped or cleared, so once the
+		//deepest path has been drawn pushing never allocates again
+		if(matrixStack.empty())
+			matrixStack.push_back(m);
+		else
+			matrixStack.push_back(matrixStack.back() * m);
+	}
 
-		return mult;
+	void pop_matrix(){
+		matrixStack.pop_back();
 	}
 
 }
\ No newline at end of file
@@ -13,38 +13,49 @@
 
 
 #include "gl_framework.hpp"
+#include "program.hpp"
+#include "scene_graph.hpp"
+#include "mesh.hpp"
+#include "instancing.hpp"
 
 
 namespace csX75	 { 
 
+	//! All HNodes keep their transforms in this one flat scene graph
+	extern SceneGraph hierarchy;
+
 	// A simple class that represents a node in the hierarchy tree
 	class HNode {
 		//glm::vec4 * vertices;
 		//glm::vec4 * colors;
-		GLfloat tx,ty,tz,rx,ry,rz;
 
-		std::size_t vertex_buffer_size;
-		std::size_t color_buffer_size;
+		//shared with every other node drawing the same vertices
+		Mesh* mesh;
 
-		GLuint num_vertices;
-		GLuint vao,vbo;
+		Program* program;
+		int uModelMatrix;
+		int uViewMatrix;
 
-		glm::mat4 rotation;
-		glm::mat4 translation;
-		
-		std::vector<HNode*> children;
-		HNode* parent;
+		//this node in the hierarchy scene graph, which holds its
+		//translation, rotation, world matrix and place in the tree
+		int node;
 
-		void update_matrices();
+		void init(HNode*, Program*);
+		void rotate(const glm::vec3&);
 
 	  public:
-		HNode (HNode*, GLuint, glm::vec4*,  glm::vec4*, std::size_t, std::size_t);
+		//the last two are an optional index list, three indices a triangle
+		HNode (HNode*, GLuint, glm::vec4*,  glm::vec4*, std::size_t, std::size_t, Program*, const GLuint* = NULL, GLsizei = 0);
+		HNode (HNode*, Mesh*, Program*);
+		~HNode();
 		//HNode (HNode* , glm::vec4*,  glm::vec4*,GLfloat,GLfloat,GLfloat,GLfloat,GLfloat,GLfloat);
 
 		void add_child(HNode*);
 		void render();
 		void change_parameters(GLfloat,GLfloat,GLfloat,GLfloat,GLfloat,GLfloat);
 		void render_tree();
+		//draws the tree with one instanced draw per mesh instead of one draw per node
+		void render_tree(InstancedRenderer&);
 		void inc_rx();
 		void inc_ry();
 		void inc_rz();
@@ -53,7 +64,11 @@ namespace csX75	 {
 		void dec_rz();
 	};
 
-	glm::mat4* multiply_stack(std::vector <glm::mat4> );
+	//! The global matrixStack holds running products: each entry is the one
+	//! below it times the matrix pushed, so the top is the full transform
+	//! and a push costs one multiply however deep the tree is.
+	void push_matrix(const glm::mat4&);
+	void pop_matrix();
 };	
 
 #endif
\ No newline at end of file
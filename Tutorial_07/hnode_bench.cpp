@@ -0,0 +1,233 @@
+/*
+  CSX75 Tutorial 7 - hierarchy traversal benchmark
+
+  Builds HNode trees offscreen (no window needed) - single chains of
+  increasing depth, and wide trees of increasing fan-out - and times
+  render_tree() on them. The nodes have no vertices, so what is measured
+  is the walk down the tree, the matrices and the uniform upload of every
+  node, not the rasterizer. Each tree is timed standing still, when the
+  cached world matrices are reused, and with its root turning every frame,
+  when all of them are recomputed. Either way the time per node should
+  stay flat as the trees get deeper. Last, the scene graph's transform pass
+  is timed on its own over a larger rig, and a tree of nodes that all draw
+  the same cuboid is built, and drawn with a draw per node and instanced.
+
+  Usage: ./hnode_bench [--frames N]
+*/
+
+#include "gl_framework.hpp"
+#include "shader_util.hpp"
+#include "hierarchy_node.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//gl_framework's keyboard callback moves these, there is no keyboard here
+GLfloat c_xrot,c_yrot,c_zrot;
+bool enable_perspective, enable_instancing;
+csX75::HNode* node1, *node2, *node3, *curr_node;
+
+std::vector<glm::mat4> matrixStack;
+
+static const char* vertex_shader =
+  "#version 330\n"
+  "in vec4 vPosition;\n"
+  "in vec4 vColor;\n"
+  "out vec4 color;\n"
+  "uniform mat4 uViewMatrix;\n"
+  "uniform mat4 uModelMatrix;\n"
+  "void main (void)\n"
+  "{\n"
+  "  gl_Position = uViewMatrix * uModelMatrix * vPosition;\n"
+  "  color = vColor;\n"
+  "}\n";
+
+static const char* instanced_vertex_shader =
+  "#version 330\n"
+  "in vec4 vPosition;\n"
+  "in vec4 vColor;\n"
+  "in mat4 vModelMatrix;\n"
+  "out vec4 color;\n"
+  "uniform mat4 uViewMatrix;\n"
+  "void main (void)\n"
+  "{\n"
+  "  gl_Position = uViewMatrix * vModelMatrix * vPosition;\n"
+  "  color = vColor;\n"
+  "}\n";
+
+static const char* fragment_shader =
+  "#version 330\n"
+  "in vec4 color;\n"
+  "out vec4 frag_color;\n"
+  "void main ()\n"
+  "{\n"
+  "  frag_color = color;\n"
+  "}\n";
+
+static glm::vec4 no_vertex(0.0f);
+
+static csX75::HNode* make_node(csX75::HNode* parent, csX75::Program* program, int index)
+{
+  csX75::HNode* node = new csX75::HNode(parent, 0, &no_vertex, &no_vertex, 0, 0, program);
+  //Every node moves and turns a little, so no product is the identity
+  node->change_parameters(0.01f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f + (index % 7));
+  return node;
+}
+
+//depth levels below the root, each node having fanout children
+static csX75::HNode* make_tree(csX75::HNode* parent, csX75::Program* program, int depth, int fanout, int &count)
+{
+  csX75::HNode* node = make_node(parent, program, count++);
+  if (depth > 0)
+    for (int i = 0; i < fanout; i++)
+      make_tree(node, program, depth - 1, fanout, count);
+  return node;
+}
+
+//ms per frame, turning the root every frame when moving
+static double time_frames(csX75::HNode* root, int frames, bool moving)
+{
+  glm::mat4 view(1.0f);
+  for (int f = 0; f < 3; f++)
+    {
+      matrixStack.clear();
+      csX75::push_matrix(view);
+      root->render_tree();
+    }
+  glFinish();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++)
+    {
+      if (moving)
+	root->inc_rz();
+      matrixStack.clear();
+      csX75::push_matrix(view);
+      root->render_tree();
+    }
+  glFinish();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+static void time_tree(const char* shape, csX75::HNode* root, int count, int depth, int frames)
+{
+  double still = time_frames(root, frames, false);
+  double moving = time_frames(root, frames, true);
+  printf("%-8s %6d %7d %10.3f %10.1f %10.3f %10.1f\n", shape, depth, count,
+	 still, still * 1.0e6 / count, moving, moving * 1.0e6 / count);
+}
+
+int main(int argc, char** argv)
+{
+  int frames = 20;
+  for (int i = 1; i < argc; i++)
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+  if (frames < 1)
+    frames = 1;
+
+  if (!csX75::initHeadlessGL(64, 64))
+    return -1;
+  csX75::initGL();
+
+  //Both programs the bench draws with, compiled and linked together
+  std::vector< std::vector<GLuint> > shaderLists(2);
+  shaderLists[0].push_back(csX75::CreateShaderGL(GL_VERTEX_SHADER, vertex_shader));
+  shaderLists[0].push_back(csX75::CreateShaderGL(GL_FRAGMENT_SHADER, fragment_shader));
+  shaderLists[1].push_back(csX75::CreateShaderGL(GL_VERTEX_SHADER, instanced_vertex_shader));
+  shaderLists[1].push_back(csX75::CreateShaderGL(GL_FRAGMENT_SHADER, fragment_shader));
+  std::vector<csX75::Program*> programs = csX75::Program::CreateAll(shaderLists);
+  csX75::Program* program = programs[0];
+  csX75::Program* instanced_program = programs[1];
+  program->use();
+
+  printf("%s\n", glGetString(GL_RENDERER));
+  printf("%-8s %6s %7s %21s %21s\n", "", "", "", "still", "root turning");
+  printf("%-8s %6s %7s %10s %10s %10s %10s\n", "tree", "depth", "nodes", "ms/frame", "ns/node", "ms/frame", "ns/node");
+
+  int depths[] = { 4, 16, 64, 256, 1024 };
+  for (int d = 0; d < (int) (sizeof(depths) / sizeof(depths[0])); d++)
+    {
+      int count = 0;
+      csX75::HNode* root = make_tree(NULL, program, depths[d] - 1, 1, count);
+      time_tree("chain", root, count, depths[d], frames);
+    }
+
+  //Fan-out 2 to 8 at depth 5, bushy rather than deep like most rigs
+  for (int fanout = 2; fanout <= 8; fanout *= 2)
+    {
+      int count = 0;
+      csX75::HNode* root = make_tree(NULL, program, 4, fanout, count);
+      time_tree("wide", root, count, 5, frames);
+    }
+
+  //The transform pass alone, without GL, on a rig with thousands of joints
+  int count = 0;
+  csX75::HNode* rig = make_tree(NULL, program, 6, 4, count);
+  csX75::hierarchy.update();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++)
+    {
+      rig->inc_rz();
+      csX75::hierarchy.update();
+    }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+  printf("\nworld matrices of %d joints, root turning: %.3f ms/frame, %.1f ns/joint\n", count, ms, ms * 1.0e6 / count);
+
+  //Many nodes with the same cuboid, as in 07_hierarchical_modelling, share one upload
+  glm::vec4 cuboid[72];
+  for (int v = 0; v < 72; v++)
+    cuboid[v] = glm::vec4((v % 3) * 0.5f, (v % 5) * 0.25f, (v % 7) * 0.125f, 1.0f);
+  unsigned long uploads = csX75::meshes.uploads;
+  std::size_t bytes = csX75::meshes.bytes();
+  glFinish();
+  start = std::chrono::steady_clock::now();
+  std::vector<csX75::HNode*> cuboids;
+  for (int i = 0; i < 10000; i++)
+    cuboids.push_back(new csX75::HNode(i == 0 ? NULL : cuboids[(i - 1) / 8], 36, cuboid, cuboid + 36,
+				       36 * sizeof(glm::vec4), 36 * sizeof(glm::vec4), program));
+  glFinish();
+  ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  printf("%d cuboid nodes built in %.3f ms, %lu mesh uploaded, %lu bytes of vertices\n", (int) cuboids.size(), ms,
+	 csX75::meshes.uploads - uploads, (unsigned long) (csX75::meshes.bytes() - bytes));
+
+  //One draw per node, against one instanced draw for the whole tree
+  csX75::InstancedRenderer* instancer = new csX75::InstancedRenderer(instanced_program);
+  for (int mode = 0; mode < 2; mode++)
+    {
+      for (int f = 0; f < frames + 3; f++)
+	{
+	  if (f == 3)
+	    {
+	      glFinish();
+	      start = std::chrono::steady_clock::now();
+	    }
+	  cuboids[0]->inc_rz();
+	  matrixStack.clear();
+	  csX75::push_matrix(glm::scale(glm::mat4(1.0f), glm::vec3(0.01f)));
+	  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	  if (mode == 0)
+	    {
+	      program->use();
+	      cuboids[0]->render_tree();
+	    }
+	  else
+	    cuboids[0]->render_tree(*instancer);
+	}
+      glFinish();
+      ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+      printf("%-9s %6d draws/frame %10.3f ms/frame\n", mode == 0 ? "per node" : "instanced",
+	     mode == 0 ? (int) cuboids.size() : (int) (instancer->draws / (frames + 3)), ms);
+    }
+
+  delete instancer;
+  delete instanced_program;
+  for (std::size_t i = 0; i < cuboids.size(); i++)
+    delete cuboids[i];
+
+  delete program;
+  csX75::terminateHeadlessGL();
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include "instancing.hpp"
+#include "gl_framework.hpp"
+
+namespace csX75
+{
+  InstancedRenderer::InstancedRenderer(Program* a_program)
+    : draws(0), instances(0), program(a_program)
+  {
+    uViewMatrix = program->uniform("uViewMatrix");
+    vPosition = program->attrib("vPosition");
+    vColor = program->attrib("vColor");
+    vModelMatrix = program->attrib("vModelMatrix");
+  }
+
+  InstancedRenderer::~InstancedRenderer()
+  {
+    clear();
+  }
+
+  InstancedRenderer::Batch &InstancedRenderer::batch(Mesh* mesh)
+  {
+    std::unordered_map<Mesh*, Batch>::iterator found = batches.find(mesh);
+    if (found != batches.end())
+      return found->second;
+
+    Batch &b = batches[mesh];
+    b.capacity = 0;
+    glGenVertexArrays(1, &b.vao);
+    glGenBuffers(1, &b.instance_vbo);
+
+    //!The mesh's own buffer, at this program's attribute locations
+    glBindVertexArray(b.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    GLint locations[2] = { vPosition, vColor };
+    mesh->layout.setupGL(locations);
+    if (mesh->ibo != 0)
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+
+    //!A mat4 attribute takes four locations, one column each, stepping once per instance
+    glBindBuffer(GL_ARRAY_BUFFER, b.instance_vbo);
+    for (int column = 0; column < 4 && vModelMatrix >= 0; column++)
+      {
+	glEnableVertexAttribArray(vModelMatrix + column);
+	glVertexAttribPointer(vModelMatrix + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+			      BUFFER_OFFSET(column * sizeof(glm::vec4)));
+	glVertexAttribDivisor(vModelMatrix + column, 1);
+      }
+    return b;
+  }
+
+  void InstancedRenderer::add(Mesh* mesh, const glm::mat4 &model)
+  {
+    Batch &b = batch(mesh);
+    if (b.models.empty())
+      used.push_back(mesh);
+    b.models.push_back(model);
+  }
+
+  void InstancedRenderer::flush(const glm::mat4 &view)
+  {
+    program->use();
+    program->set(uViewMatrix, view);
+    for (std::size_t i = 0; i < used.size(); i++)
+      {
+	Batch &b = batches[used[i]];
+	GLsizeiptr size = b.models.size() * sizeof(glm::mat4);
+	glBindBuffer(GL_ARRAY_BUFFER, b.instance_vbo);
+	//!Orphan the old storage, so the GPU can still be reading last frame's matrices
+	if (size > b.capacity)
+	  b.capacity = size;
+	glBufferData(GL_ARRAY_BUFFER, b.capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, b.models.data());
+
+	glBindVertexArray(b.vao);
+	if (used[i]->ibo != 0)
+	  glDrawElementsInstanced(GL_TRIANGLES, used[i]->count, used[i]->index_type, BUFFER_OFFSET(0),
+				  b.models.size());
+	else
+	  glDrawArraysInstanced(GL_TRIANGLES, used[i]->first, used[i]->count, b.models.size());
+	draws++;
+	instances += b.models.size();
+	b.models.clear();
+      }
+    used.clear();
+  }
+
+  void InstancedRenderer::clear(void)
+  {
+    for (std::unordered_map<Mesh*, Batch>::iterator b = batches.begin(); b != batches.end(); ++b)
+      {
+	glDeleteBuffers(1, &b->second.instance_vbo);
+	glDeleteVertexArrays(1, &b->second.vao);
+      }
+    batches.clear();
+    used.clear();
+  }
+};
@@ -0,0 +1,60 @@
+#ifndef _INSTANCING_HPP_
+#define _INSTANCING_HPP_
+
+#include <GL/glew.h>
+
+#include <unordered_map>
+#include <vector>
+#include "glm/mat4x4.hpp"
+
+#include "mesh.hpp"
+#include "program.hpp"
+
+namespace csX75
+{
+  //! Draws many copies of the same meshes with one call per mesh. add() files
+  //! a mesh with the model matrix of one copy, and flush() puts the matrices of
+  //! each mesh in a buffer of its own and draws all its copies together with
+  //! glDrawArraysInstanced, or glDrawElementsInstanced. The program reads the matrix as a per-instance
+  //! mat4 attribute, vModelMatrix, as in 07_vshader_instanced.glsl.
+  //!
+  //! A mesh keeps its batch, with a VAO for this program, until clear() or the
+  //! renderer is deleted, which has to happen before the mesh is released.
+  class InstancedRenderer
+  {
+  public:
+    //! program takes vPosition, vColor, vModelMatrix and the uViewMatrix uniform
+    InstancedRenderer(Program* program);
+    ~InstancedRenderer();
+
+    void add(Mesh* mesh, const glm::mat4 &model);
+    //! Draw everything added since the last flush, leaves program in use
+    void flush(const glm::mat4 &view);
+    //! Drop the batches and their buffers
+    void clear(void);
+
+    Program* get_program(void) const { return program; }
+
+    //! Instanced draws issued, and copies drawn by them, since the start
+    unsigned long draws, instances;
+
+  private:
+    struct Batch
+    {
+      GLuint vao, instance_vbo;
+      GLsizeiptr capacity;   // bytes allocated for instance_vbo
+      std::vector<glm::mat4> models;
+    };
+
+    Batch &batch(Mesh* mesh);
+
+    Program* program;
+    int uViewMatrix;
+    GLint vPosition, vColor, vModelMatrix;
+    std::unordered_map<Mesh*, Batch> batches;
+    //!Meshes in the order they were first added this frame
+    std::vector<Mesh*> used;
+  };
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "mesh.hpp"
+#include "gl_framework.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace csX75
+{
+  MeshRegistry meshes;
+
+  //!The draw, the attribute locations and every vertex and index byte, one after another
+  static std::vector<unsigned char> mesh_source(GLuint num_vertices, const void* vertices, const void* colours,
+						std::size_t v_size, std::size_t c_size, GLint vPosition, GLint vColor,
+						const GLuint* indices, GLsizei num_indices)
+  {
+    const unsigned long long header[6] = { num_vertices, v_size, c_size,
+					   (unsigned long long) vPosition, (unsigned long long) vColor,
+					   (unsigned long long) num_indices };
+    const void* blocks[4] = { header, vertices, colours, indices };
+    std::size_t sizes[4] = { sizeof(header), v_size, c_size, num_indices * sizeof(GLuint) };
+    std::vector<unsigned char> source;
+    source.reserve(sizes[0] + sizes[1] + sizes[2] + sizes[3]);
+    for (int b = 0; b < 4; b++)
+      source.insert(source.end(), (const unsigned char*) blocks[b], (const unsigned char*) blocks[b] + sizes[b]);
+    return source;
+  }
+
+  //!FNV-1a over the source of a mesh
+  static unsigned long long mesh_key(const std::vector<unsigned char> &source)
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < source.size(); i++)
+      {
+	hash ^= source[i];
+	hash *= 1099511628211ULL;
+      }
+    return hash;
+  }
+
+  MeshRegistry::MeshRegistry()
+    : requests(0), uploads(0), total_bytes(0)
+  {
+  }
+
+  Mesh* MeshRegistry::acquire(GLuint num_vertices, const glm::vec4* vertices, const glm::vec4* colours,
+			      std::size_t v_size, std::size_t c_size, const Program* program,
+			      const GLuint* indices, GLsizei num_indices)
+  {
+    GLint vPosition = program->attrib("vPosition");
+    GLint vColor = program->attrib("vColor");
+    if (colours == NULL)
+      c_size = 0;
+    if (indices == NULL)
+      num_indices = 0;
+    std::vector<unsigned char> source = mesh_source(num_vertices, vertices, colours, v_size, c_size,
+						    vPosition, vColor, indices, num_indices);
+    unsigned long long key = mesh_key(source);
+
+    //!Only a mesh made from the same arrays will do, not just one with the same hash
+    requests++;
+    typedef std::unordered_multimap<unsigned long long, Mesh*>::iterator Entry;
+    std::pair<Entry, Entry> same_key = meshes.equal_range(key);
+    for (Entry found = same_key.first; found != same_key.second; ++found)
+      if (found->second->source == source)
+	return acquire(found->second);
+
+    Mesh* mesh = new Mesh;
+    mesh->ibo = 0;
+    mesh->first = 0;
+    mesh->count = num_vertices;
+    mesh->index_type = GL_UNSIGNED_INT;
+    mesh->layout.add(VERTEX_FLOAT3);
+    if (c_size > 0)
+      mesh->layout.add(VERTEX_UNORM8);
+    mesh->bytes = num_vertices * mesh->layout.stride();
+    mesh->refs = 1;
+    mesh->key = key;
+    mesh->source.swap(source);
+
+    glGenVertexArrays(1, &mesh->vao);
+    glGenBuffers(1, &mesh->vbo);
+    glBindVertexArray(mesh->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+
+    //!Each vertex in one piece, 16 bytes with a colour rather than 32
+    const glm::vec4* arrays[2] = { vertices, colours };
+    std::vector<unsigned char> interleaved = mesh->layout.interleave(num_vertices, arrays);
+    glBufferData(GL_ARRAY_BUFFER, interleaved.size(), interleaved.data(), GL_STATIC_DRAW);
+
+    //!Set up the vertex array as per the shader
+    GLint locations[2] = { vPosition, vColor };
+    mesh->layout.setupGL(locations);
+
+    //!The index buffer is part of the VAO's state, 16 bit when every index fits
+    if (num_indices > 0)
+      {
+	glGenBuffers(1, &mesh->ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+	mesh->count = num_indices;
+	if (*std::max_element(indices, indices + num_indices) <= 0xffff)
+	  {
+	    std::vector<GLushort> narrow(indices, indices + num_indices);
+	    mesh->index_type = GL_UNSIGNED_SHORT;
+	    mesh->bytes += num_indices * sizeof(GLushort);
+	    glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(GLushort), narrow.data(), GL_STATIC_DRAW);
+	  }
+	else
+	  {
+	    mesh->bytes += num_indices * sizeof(GLuint);
+	    glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+	  }
+      }
+
+    meshes.insert(std::make_pair(key, mesh));
+    total_bytes += mesh->bytes;
+    uploads++;
+    return mesh;
+  }
+
+  Mesh* MeshRegistry::acquire(Mesh* mesh)
+  {
+    mesh->refs++;
+    return mesh;
+  }
+
+  void MeshRegistry::release(Mesh* mesh)
+  {
+    if (mesh == NULL || --mesh->refs > 0)
+      return;
+    glDeleteBuffers(1, &mesh->vbo);
+    if (mesh->ibo != 0)
+      glDeleteBuffers(1, &mesh->ibo);
+    glDeleteVertexArrays(1, &mesh->vao);
+    typedef std::unordered_multimap<unsigned long long, Mesh*>::iterator Entry;
+    std::pair<Entry, Entry> same_key = meshes.equal_range(mesh->key);
+    for (Entry found = same_key.first; found != same_key.second; ++found)
+      if (found->second == mesh)
+	{
+	  meshes.erase(found);
+	  break;
+	}
+    total_bytes -= mesh->bytes;
+    delete mesh;
+  }
+};
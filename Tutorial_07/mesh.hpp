@@ -0,0 +1,71 @@
+#ifndef _MESH_HPP_
+#define _MESH_HPP_
+
+#include <GL/glew.h>
+
+#include <unordered_map>
+#include <vector>
+#include "glm/vec4.hpp"
+
+#include "program.hpp"
+#include "vertex_layout.hpp"
+
+namespace csX75
+{
+  //! Geometry on the GPU, set up for one program's attributes, that any number
+  //! of nodes can draw. Nodes hold a reference each, counted in refs.
+  //! With an index buffer, ibo is set and count is the number of indices.
+  //! The vertices in vbo are interleaved as in layout: the position, then
+  //! the colour if there is one.
+  struct Mesh
+  {
+    GLuint vao, vbo, ibo;
+    GLint first;
+    GLsizei count;
+    GLenum index_type;           // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT with an ibo
+    std::size_t bytes;
+    VertexLayout layout;
+    int refs;
+    unsigned long long key;
+    std::vector<unsigned char> source;   // everything key was hashed from
+  };
+
+  //! Hands out one Mesh per distinct set of vertex arrays. A second request
+  //! for the same positions and colours, for the same attribute locations,
+  //! gets the Mesh already uploaded, so GPU memory and upload time grow with
+  //! the number of different meshes and not with the number of nodes.
+  //! Meshes are found by a hash of their arrays, and a mesh with the same
+  //! hash is only handed out if its arrays are the same too.
+  class MeshRegistry
+  {
+  public:
+    MeshRegistry();
+
+    //! A reference to the mesh of these arrays, uploading them the first time.
+    //! Colours may be NULL with c_size 0 for a mesh without them. Positions
+    //! are stored as three floats and colours as four bytes. With
+    //! indices, the mesh is drawn as the num_indices / 3 triangles they list.
+    Mesh* acquire(GLuint num_vertices, const glm::vec4* vertices, const glm::vec4* colours,
+		  std::size_t v_size, std::size_t c_size, const Program* program,
+		  const GLuint* indices = NULL, GLsizei num_indices = 0);
+    //! Take one more reference to a mesh already held
+    Mesh* acquire(Mesh* mesh);
+    //! Drop a reference, the buffers are freed with the last one
+    void release(Mesh* mesh);
+
+    //! Meshes alive and the bytes of vertex data they hold on the GPU
+    std::size_t size(void) const { return meshes.size(); }
+    std::size_t bytes(void) const { return total_bytes; }
+    //! Meshes asked for and meshes actually uploaded, since the start
+    unsigned long requests, uploads;
+
+  private:
+    std::unordered_multimap<unsigned long long, Mesh*> meshes;
+    std::size_t total_bytes;
+  };
+
+  //! The registry the hierarchy nodes share their geometry through
+  extern MeshRegistry meshes;
+};
+
+#endif
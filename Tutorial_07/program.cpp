@@ -0,0 +1,142 @@
+#include "program.hpp"
+#include "shader_util.hpp"
+
+#include <cstring>
+#include "glm/gtc/type_ptr.hpp"
+
+namespace csX75
+{
+  //!Room for the largest value set() takes, a mat4
+  static const std::size_t shadow_slot = sizeof(glm::mat4);
+
+  Program::Program(const std::vector<GLuint> &shaderList)
+    : uploads(0), skipped(0)
+  {
+    program = CreateProgramGL(shaderList);
+    lookup();
+  }
+
+  Program::Program(GLuint linked)
+    : uploads(0), skipped(0), program(linked)
+  {
+    lookup();
+  }
+
+  std::vector<Program*> Program::CreateAll(const std::vector< std::vector<GLuint> > &shaderLists)
+  {
+    std::vector<GLuint> linked = CreateProgramsGL(shaderLists);
+    std::vector<Program*> programs(linked.size());
+    for (std::size_t i = 0; i < linked.size(); i++)
+      programs[i] = new Program(linked[i]);
+    return programs;
+  }
+
+  void Program::lookup(void)
+  {
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::vector<GLchar> name(max_length + 1);
+    for (GLint i = 0; i < count; i++)
+      {
+	GLint size;
+	GLenum type;
+	glGetActiveUniform(program, i, max_length + 1, NULL, &size, &type, name.data());
+	//!Members of a uniform block have no location, they are set through its buffer
+	GLint location = glGetUniformLocation(program, name.data());
+	if (location < 0)
+	  continue;
+
+	Uniform entry;
+	entry.location = location;
+	entry.last_type = GL_NONE;
+	entry.offset = uniforms.size() * shadow_slot;
+	uniform_table[name.data()] = (int) uniforms.size();
+	//!An array is listed as "name[0]", but is just as often asked for as "name"
+	std::string key = name.data();
+	if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+	  uniform_table[key.substr(0, key.size() - 3)] = (int) uniforms.size();
+	uniforms.push_back(entry);
+      }
+    shadow.resize(uniforms.size() * shadow_slot);
+
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+    name.resize(max_length + 1);
+    for (GLint i = 0; i < count; i++)
+      {
+	GLint size;
+	GLenum type;
+	glGetActiveAttrib(program, i, max_length + 1, NULL, &size, &type, name.data());
+	attrib_table[name.data()] = glGetAttribLocation(program, name.data());
+      }
+  }
+
+  Program::~Program()
+  {
+    glDeleteProgram(program);
+  }
+
+  int Program::uniform(const std::string &name) const
+  {
+    std::unordered_map<std::string, int>::const_iterator entry = uniform_table.find(name);
+    return entry == uniform_table.end() ? -1 : entry->second;
+  }
+
+  GLint Program::attrib(const std::string &name) const
+  {
+    std::unordered_map<std::string, GLint>::const_iterator entry = attrib_table.find(name);
+    return entry == attrib_table.end() ? -1 : entry->second;
+  }
+
+  bool Program::changed(int handle, GLenum type, const void* value, std::size_t size)
+  {
+    Uniform &entry = uniforms[handle];
+    unsigned char* last = &shadow[entry.offset];
+    if (entry.last_type == type && memcmp(last, value, size) == 0)
+      {
+	skipped++;
+	return false;
+      }
+    entry.last_type = type;
+    memcpy(last, value, size);
+    uploads++;
+    return true;
+  }
+
+  void Program::set(int handle, const glm::mat4 &value)
+  {
+    if (handle >= 0 && changed(handle, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value)))
+      glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+  }
+
+  void Program::set(int handle, const glm::mat3 &value)
+  {
+    if (handle >= 0 && changed(handle, GL_FLOAT_MAT3, glm::value_ptr(value), sizeof(value)))
+      glUniformMatrix3fv(uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+  }
+
+  void Program::set(int handle, const glm::vec4 &value)
+  {
+    if (handle >= 0 && changed(handle, GL_FLOAT_VEC4, glm::value_ptr(value), sizeof(value)))
+      glUniform4fv(uniforms[handle].location, 1, glm::value_ptr(value));
+  }
+
+  void Program::set(int handle, const glm::vec3 &value)
+  {
+    if (handle >= 0 && changed(handle, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value)))
+      glUniform3fv(uniforms[handle].location, 1, glm::value_ptr(value));
+  }
+
+  void Program::set(int handle, GLfloat value)
+  {
+    if (handle >= 0 && changed(handle, GL_FLOAT, &value, sizeof(value)))
+      glUniform1f(uniforms[handle].location, value);
+  }
+
+  void Program::set(int handle, GLint value)
+  {
+    if (handle >= 0 && changed(handle, GL_INT, &value, sizeof(value)))
+      glUniform1i(uniforms[handle].location, value);
+  }
+};
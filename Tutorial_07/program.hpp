@@ -0,0 +1,74 @@
+#ifndef _PROGRAM_HPP_
+#define _PROGRAM_HPP_
+
+#include <GL/glew.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/mat3x3.hpp"
+#include "glm/mat4x4.hpp"
+
+namespace csX75
+{
+  //! A linked program with its active uniforms and attributes looked up once,
+  //! by name, into hash tables. Uniforms are set through a small integer handle,
+  //! and a value equal to the last one set is not sent to GL again.
+  class Program
+  {
+  public:
+    //! Link the shaders with CreateProgramGL
+    Program(const std::vector<GLuint> &shaderList);
+    //! Take over a program that is already linked
+    explicit Program(GLuint linked);
+    ~Program();
+
+    //! Link one program for each list with CreateProgramsGL, which issues
+    //! every compile and link before it waits on any, so a driver that
+    //! compiles in parallel builds them side by side
+    static std::vector<Program*> CreateAll(const std::vector< std::vector<GLuint> > &shaderLists);
+
+    GLuint id(void) const { return program; }
+    void use(void) const { glUseProgram(program); }
+
+    //! Handle of an active uniform, -1 if the program has none by that name
+    int uniform(const std::string &name) const;
+    //! Location of an active attribute, -1 if there is none
+    GLint attrib(const std::string &name) const;
+
+    //! Set a uniform of the program, which has to be the one in use.
+    //! A handle of -1 is ignored, like a location of -1 in glUniform*.
+    void set(int handle, const glm::mat4 &value);
+    void set(int handle, const glm::mat3 &value);
+    void set(int handle, const glm::vec4 &value);
+    void set(int handle, const glm::vec3 &value);
+    void set(int handle, GLfloat value);
+    void set(int handle, GLint value);
+
+    //! glUniform* calls made and skipped since the program was created
+    unsigned long uploads, skipped;
+
+  private:
+    struct Uniform
+    {
+      GLint location;
+      GLenum last_type;     // GL_NONE until it has been set once
+      std::size_t offset;   // of its last value in shadow
+    };
+
+    //! Look up the active uniforms and attributes of program
+    void lookup(void);
+    //! True if the value differs from the last one set, which it then replaces
+    bool changed(int handle, GLenum type, const void* value, std::size_t size);
+
+    GLuint program;
+    std::vector<Uniform> uniforms;
+    std::unordered_map<std::string, int> uniform_table;
+    std::unordered_map<std::string, GLint> attrib_table;
+    std::vector<unsigned char> shadow;
+  };
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "scene_graph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace csX75
+{
+  //! Translation times the rotations about x, y and z, written out rather
+  //! than built from four matrix products
+  static glm::mat4 local_matrix(const glm::vec3 &t, const glm::vec3 &r)
+  {
+    float sa = sinf(glm::radians(r.x)), ca = cosf(glm::radians(r.x));
+    float sb = sinf(glm::radians(r.y)), cb = cosf(glm::radians(r.y));
+    float sc = sinf(glm::radians(r.z)), cc = cosf(glm::radians(r.z));
+    return glm::mat4(cb * cc, sa * sb * cc + ca * sc, sa * sc - ca * sb * cc, 0.0f,
+		     -cb * sc, ca * cc - sa * sb * sc, ca * sb * sc + sa * cc, 0.0f,
+		     sb, -sa * cb, ca * cb, 0.0f,
+		     t.x, t.y, t.z, 1.0f);
+  }
+
+  SceneGraph::SceneGraph()
+    : sorted(true), any_dirty(false)
+  {
+  }
+
+  int SceneGraph::add_node(int parent)
+  {
+    int node = (int) slot_of.size();
+    slot_of.push_back((int) handles.size());
+    parents.push_back(-1);
+    first_child.push_back(-1);
+    last_child.push_back(-1);
+    next_sibling.push_back(-1);
+
+    parent_slots.push_back(-1);
+    translations.push_back(glm::vec3(0.0f));
+    rotations.push_back(glm::vec3(0.0f));
+    worlds.push_back(glm::mat4(1.0f));
+    dirty.push_back(1);
+    subtree_sizes.push_back(1);
+    handles.push_back(node);
+    any_dirty = true;
+
+    if (parent >= 0)
+      set_parent(node, parent);
+    return node;
+  }
+
+  void SceneGraph::set_parent(int node, int parent)
+  {
+    //!A node cannot go under itself or anything below it
+    for (int above = parent; above >= 0; above = parents[above])
+      if (above == node)
+	{
+	  std::cerr<<"SceneGraph: node "<<node<<" cannot be its own ancestor"<<std::endl;
+	  return;
+	}
+
+    int old_parent = parents[node];
+    if (old_parent >= 0)
+      {
+	int previous = -1;
+	for (int child = first_child[old_parent]; child != node; child = next_sibling[child])
+	  previous = child;
+	if (previous < 0)
+	  first_child[old_parent] = next_sibling[node];
+	else
+	  next_sibling[previous] = next_sibling[node];
+	if (last_child[old_parent] == node)
+	  last_child[old_parent] = previous;
+	next_sibling[node] = -1;
+      }
+
+    parents[node] = parent;
+    if (parent >= 0)
+      {
+	if (last_child[parent] < 0)
+	  first_child[parent] = node;
+	else
+	  next_sibling[last_child[parent]] = node;
+	last_child[parent] = node;
+      }
+
+    dirty[slot_of[node]] = 1;
+    any_dirty = true;
+    sorted = false;
+  }
+
+  void SceneGraph::set_transform(int node, const glm::vec3 &translation, const glm::vec3 &rotation)
+  {
+    int slot = slot_of[node];
+    translations[slot] = translation;
+    rotations[slot] = rotation;
+    dirty[slot] = 1;
+    any_dirty = true;
+  }
+
+  void SceneGraph::sort(void)
+  {
+    //!Depth first, the roots and the children of each node in the order they were added
+    std::vector<int> order;
+    order.reserve(handles.size());
+    std::vector<int> stack;
+    for (int root = 0; root < (int) parents.size(); root++)
+      {
+	if (parents[root] >= 0)
+	  continue;
+	stack.push_back(root);
+	while (!stack.empty())
+	  {
+	    int node = stack.back();
+	    stack.pop_back();
+	    order.push_back(node);
+	    //!Pushed last to first so that they come off first to last
+	    std::size_t mark = stack.size();
+	    for (int child = first_child[node]; child >= 0; child = next_sibling[child])
+	      stack.push_back(child);
+	    std::reverse(stack.begin() + mark, stack.end());
+	  }
+      }
+
+    std::size_t count = order.size();
+    std::vector<int> new_parent_slots(count);
+    std::vector<glm::vec3> new_translations(count), new_rotations(count);
+    std::vector<glm::mat4> new_worlds(count);
+    std::vector<unsigned char> new_dirty(count);
+    for (std::size_t i = 0; i < count; i++)
+      {
+	int old_slot = slot_of[order[i]];
+	new_translations[i] = translations[old_slot];
+	new_rotations[i] = rotations[old_slot];
+	new_worlds[i] = worlds[old_slot];
+	new_dirty[i] = dirty[old_slot];
+      }
+    for (std::size_t i = 0; i < count; i++)
+      slot_of[order[i]] = (int) i;
+    for (std::size_t i = 0; i < count; i++)
+      new_parent_slots[i] = parents[order[i]] < 0 ? -1 : slot_of[parents[order[i]]];
+
+    parent_slots.swap(new_parent_slots);
+    translations.swap(new_translations);
+    rotations.swap(new_rotations);
+    worlds.swap(new_worlds);
+    dirty.swap(new_dirty);
+    handles.swap(order);
+
+    //!Children come after their parent, so going backwards every subtree is complete
+    std::fill(subtree_sizes.begin(), subtree_sizes.end(), 1);
+    for (std::size_t i = count; i-- > 1; )
+      if (parent_slots[i] >= 0)
+	subtree_sizes[parent_slots[i]] += subtree_sizes[i];
+
+    sorted = true;
+  }
+
+  void SceneGraph::update(void)
+  {
+    if (!sorted)
+      sort();
+    if (!any_dirty)
+      return;
+
+    //!A parent has always been handled by the time its children are reached,
+    //!so a moved parent passes its flag down in the same pass
+    std::size_t count = handles.size();
+    for (std::size_t i = 0; i < count; i++)
+      {
+	int parent = parent_slots[i];
+	if (parent >= 0)
+	  dirty[i] |= dirty[parent];
+	if (!dirty[i])
+	  continue;
+
+	glm::mat4 local = local_matrix(translations[i], rotations[i]);
+	worlds[i] = parent < 0 ? local : worlds[parent] * local;
+      }
+    std::fill(dirty.begin(), dirty.end(), 0);
+    any_dirty = false;
+  }
+};
@@ -0,0 +1,69 @@
+#ifndef _SCENE_GRAPH_HPP_
+#define _SCENE_GRAPH_HPP_
+
+#include <vector>
+#include "glm/vec3.hpp"
+#include "glm/mat4x4.hpp"
+
+namespace csX75
+{
+  //! The transforms of a whole hierarchy, kept flat. Nodes are stored in
+  //! contiguous arrays, one per field, in depth first order: a parent always
+  //! comes before its children and a subtree is a run of consecutive slots.
+  //! update() then brings every world matrix up to date in one pass from
+  //! the first slot to the last, without following a single pointer.
+  //!
+  //! A node is named by the handle add_node() returns, which stays valid when
+  //! the slots are reordered. Only nodes whose translation or rotation changed,
+  //! and the nodes below them, have their matrices recomputed.
+  class SceneGraph
+  {
+  public:
+    SceneGraph();
+
+    //! A new node with no translation or rotation, parent -1 for a root
+    int add_node(int parent);
+    //! Move a node, with its subtree, under another parent (-1 for a root)
+    void set_parent(int node, int parent);
+
+    //! Translation, and rotation in degrees about x, then y, then z
+    void set_transform(int node, const glm::vec3 &translation, const glm::vec3 &rotation);
+    const glm::vec3 &translation(int node) const { return translations[slot_of[node]]; }
+    const glm::vec3 &rotation(int node) const { return rotations[slot_of[node]]; }
+
+    //! Reorder the slots if the hierarchy changed, then recompute stale world matrices
+    void update(void);
+
+    //! Transform from the node to the root of its tree, as of the last update()
+    const glm::mat4 &world(int node) const { return worlds[slot_of[node]]; }
+
+    //! Slots in depth first order: the node's subtree is slots
+    //! [slot(node), slot(node) + subtree_size(node)) after update()
+    int slot(int node) const { return slot_of[node]; }
+    int subtree_size(int node) const { return subtree_sizes[slot_of[node]]; }
+    int node_at(int slot) const { return handles[slot]; }
+    int size(void) const { return (int) handles.size(); }
+
+  private:
+    //! Put the slots back in depth first order
+    void sort(void);
+
+    //!Per slot, hot data touched by update()
+    std::vector<int> parent_slots;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::vec3> rotations;
+    std::vector<glm::mat4> worlds;
+    std::vector<unsigned char> dirty;
+    std::vector<int> subtree_sizes;
+    std::vector<int> handles;
+
+    //!Per handle, the shape of the tree, only walked by sort()
+    std::vector<int> slot_of;
+    std::vector<int> parents, first_child, last_child, next_sibling;
+
+    bool sorted;
+    bool any_dirty;
+  };
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "vertex_layout.hpp"
+#include "gl_framework.hpp"
+
+#include <cstring>
+#include "glm/packing.hpp"
+#include "glm/gtc/packing.hpp"
+
+namespace csX75
+{
+  //!Bytes, components and GL type of each format, in the order of VertexFormat
+  static const GLsizei format_bytes[] = { 12, 4, 4, 4 };
+  static const GLint format_size[] = { 3, 2, 4, 4 };
+  static const GLenum format_type[] = { GL_FLOAT, GL_HALF_FLOAT, GL_INT_2_10_10_10_REV, GL_UNSIGNED_BYTE };
+  static const GLboolean format_normalized[] = { GL_FALSE, GL_FALSE, GL_TRUE, GL_TRUE };
+
+  VertexLayout::VertexLayout()
+    : vertex_stride(0)
+  {
+  }
+
+  int VertexLayout::add(VertexFormat format)
+  {
+    Attribute a = { format, vertex_stride };
+    attributes.push_back(a);
+    vertex_stride += format_bytes[format];
+    return attributes.size() - 1;
+  }
+
+  void VertexLayout::pack(void* vertex, int a, const glm::vec4 &value) const
+  {
+    unsigned char* out = (unsigned char*) vertex + attributes[a].offset;
+    glm::uint packed;
+    switch (attributes[a].format)
+      {
+      case VERTEX_FLOAT3:
+	memcpy(out, &value[0], 3 * sizeof(float));
+	return;
+      case VERTEX_HALF2:
+	packed = glm::packHalf2x16(glm::vec2(value));
+	break;
+      case VERTEX_SNORM10:
+	packed = glm::packSnorm3x10_1x2(value);
+	break;
+      default:
+	packed = glm::packUnorm4x8(value);
+	break;
+      }
+    memcpy(out, &packed, sizeof(packed));
+  }
+
+  std::vector<unsigned char> VertexLayout::interleave(std::size_t count, const glm::vec4* const* arrays) const
+  {
+    std::vector<unsigned char> vertices(count * vertex_stride);
+    for (std::size_t v = 0; v < count; v++)
+      for (std::size_t a = 0; a < attributes.size(); a++)
+	pack(&vertices[v * vertex_stride], a, arrays[a][v]);
+    return vertices;
+  }
+
+  void VertexLayout::setupGL(const GLint* locations, std::size_t offset) const
+  {
+    for (std::size_t a = 0; a < attributes.size(); a++)
+      {
+	if (locations[a] < 0)
+	  continue;
+	VertexFormat format = attributes[a].format;
+	glEnableVertexAttribArray(locations[a]);
+	glVertexAttribPointer(locations[a], format_size[format], format_type[format], format_normalized[format],
+			      vertex_stride, BUFFER_OFFSET(offset + attributes[a].offset));
+      }
+  }
+};
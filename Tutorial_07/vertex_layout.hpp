@@ -0,0 +1,58 @@
+#ifndef _VERTEX_LAYOUT_HPP_
+#define _VERTEX_LAYOUT_HPP_
+
+#include <GL/glew.h>
+
+#include <vector>
+#include "glm/vec4.hpp"
+
+namespace csX75
+{
+  //! How one attribute is stored in a vertex. Each takes a multiple of 4
+  //! bytes, so every attribute of an interleaved vertex stays aligned.
+  enum VertexFormat
+  {
+    VERTEX_FLOAT3,      // x, y, z as floats, 12 bytes, a vec4 reads w as 1
+    VERTEX_HALF2,       // x, y as half floats, 4 bytes, for texture coordinates
+    VERTEX_SNORM10,     // x, y, z in [-1, 1] to 10 bits and w to 2, 4 bytes, for normals
+    VERTEX_UNORM8       // x, y, z, w in [0, 1] to 8 bits, 4 bytes, for colours
+  };
+
+  //! The attributes of one vertex, one after another in the order they were
+  //! added, and vertices one after another stride() bytes apart. Compared to
+  //! a vec4 array for each attribute, one vertex is a single fetch and
+  //! takes half the memory or less.
+  class VertexLayout
+  {
+  public:
+    VertexLayout();
+
+    //! Append an attribute, returns its index
+    int add(VertexFormat format);
+    //! Bytes from one vertex to the next
+    GLsizei stride(void) const { return vertex_stride; }
+    //! Number of attributes
+    std::size_t size(void) const { return attributes.size(); }
+
+    //! Store value as attribute a of the vertex at vertex
+    void pack(void* vertex, int a, const glm::vec4 &value) const;
+    //! Interleave count vertices, attribute a taken from arrays[a]
+    std::vector<unsigned char> interleave(std::size_t count, const glm::vec4* const* arrays) const;
+
+    //! Point the bound VAO's attributes into the bound GL_ARRAY_BUFFER, with
+    //! the vertices starting offset bytes in. The program reads attribute a
+    //! at locations[a], or not at all if that is -1, and then it is skipped.
+    void setupGL(const GLint* locations, std::size_t offset = 0) const;
+
+  private:
+    struct Attribute
+    {
+      VertexFormat format;
+      GLsizei offset;
+    };
+    std::vector<Attribute> attributes;
+    GLsizei vertex_stride;
+  };
+};
+
+#endif
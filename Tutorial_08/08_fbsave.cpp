@@ -12,9 +12,16 @@
 
 #include "08_fbsave.hpp"
 #include "texture.hpp"
+#include "program.hpp"
+#include "frame_uniforms.hpp"
+#include "vertex_layout.hpp"
 
-GLuint shaderProgram;
+csX75::Program* shaderProgram;
 GLuint vbo[2], vao[2];
+//Anisotropic filtering, off unless asked for with --anisotropy N
+float max_anisotropy = 1.0f;
+//Print the uniform counters of the program on exit
+bool show_stats=false;
 GLuint tex;
 
 glm::mat4 rotation_matrix;
@@ -29,9 +36,11 @@ glm::mat4 view_matrix;
 glm::mat4 modelview_matrix;
 glm::mat3 normal_matrix;
 
-GLuint uModelViewMatrix;
-GLuint viewMatrix;
-GLuint normalMatrix;
+int uModelMatrix;
+int normalMatrix;
+//Camera matrices shared by every program, uploaded once a frame
+GLuint frame_ubo;
+FrameUniforms frame_uniforms;
 //-----------------------------------------------------------------
 
 //6 faces, 2 triangles/face, 3 vertices/triangle
@@ -146,20 +155,20 @@ void initBuffersGL(void)
   shaderList.push_back(csX75::LoadShaderGL(GL_VERTEX_SHADER, vertex_shader_file));
   shaderList.push_back(csX75::LoadShaderGL(GL_FRAGMENT_SHADER, fragment_shader_file));
 
-  shaderProgram = csX75::CreateProgramGL(shaderList);
-  glUseProgram( shaderProgram );
+  shaderProgram = new csX75::Program(shaderList);
+  shaderProgram->use();
 
-  // getting the attributes from the shader program
-  GLuint vPosition = glGetAttribLocation( shaderProgram, "vPosition" );
-  GLuint vColor = glGetAttribLocation( shaderProgram, "vColor" ); 
-  GLuint vNormal = glGetAttribLocation( shaderProgram, "vNormal" ); 
-  GLuint texCoord = glGetAttribLocation( shaderProgram, "texCoord" ); 
-  uModelViewMatrix = glGetUniformLocation( shaderProgram, "uModelViewMatrix");
-  normalMatrix =  glGetUniformLocation( shaderProgram, "normalMatrix");
-  viewMatrix = glGetUniformLocation( shaderProgram, "viewMatrix");
+  // getting the attributes and uniform handles from the shader program
+  GLint vPosition = shaderProgram->attrib("vPosition");
+  GLint vNormal = shaderProgram->attrib("vNormal");
+  GLint texCoord = shaderProgram->attrib("texCoord");
+  uModelMatrix = shaderProgram->uniform("uModelMatrix");
+  normalMatrix = shaderProgram->uniform("normalMatrix");
+  frame_ubo = csX75::CreateFrameUniformsGL();
+  csX75::BindFrameUniformsGL(shaderProgram->id());
 
   // Load Textures 
-  GLuint tex=LoadTexture("images/all1.bmp",256,256);
+  GLuint tex=LoadTexture("images/all1.bmp",256,256,TEXTURE_MIPMAP,max_anisotropy);
   glBindTexture(GL_TEXTURE_2D, tex);
 
   //Ask GL for two Vertex Attribute Objects (vao) , one for the sphere and one for the wireframe
@@ -174,22 +183,26 @@ void initBuffersGL(void)
 
   colorcube();
 
-  //Copy the points into the current buffer
-  glBufferData (GL_ARRAY_BUFFER, sizeof (v_positions) + sizeof(tex_coords) + sizeof(v_normals), NULL, GL_STATIC_DRAW);
-  glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(v_positions), v_positions );
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(v_positions), sizeof(tex_coords), tex_coords);
-  glBufferSubData( GL_ARRAY_BUFFER, sizeof(tex_coords)+sizeof(v_positions), sizeof(v_normals), v_normals );
-  // set up vertex array
-  //Position
-  glEnableVertexAttribArray( vPosition );
-  glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-  //Textures
-  glEnableVertexAttribArray( texCoord );
-  glVertexAttribPointer( texCoord, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(v_positions)) );
-
-  //Normal
-  glEnableVertexAttribArray( vNormal );
-  glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(v_positions)+sizeof(tex_coords)) );
+  //Copy the points into the current buffer, each vertex in one piece: the
+  //position as three floats, the texture coordinates as two half floats and
+  //the normal in 10 bits a component, 20 bytes where a vec4, a vec2 and a
+  //vec4 took 40
+  csX75::VertexLayout layout;
+  layout.add(csX75::VERTEX_FLOAT3);
+  layout.add(csX75::VERTEX_HALF2);
+  layout.add(csX75::VERTEX_SNORM10);
+  std::vector<unsigned char> vertices(num_vertices * layout.stride());
+  for (int v = 0; v < num_vertices; v++)
+    {
+      unsigned char* vertex = &vertices[v * layout.stride()];
+      layout.pack(vertex, 0, v_positions[v]);
+      layout.pack(vertex, 1, glm::vec4(tex_coords[v], 0.0, 0.0));
+      layout.pack(vertex, 2, v_normals[v]);
+    }
+  glBufferData (GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+  // set up vertex array, skipping the attributes the shader does not read
+  GLint locations[3] = { vPosition, texCoord, vNormal };
+  layout.setupGL(locations);
 
   
 
@@ -200,6 +213,8 @@ void renderGL(void)
 {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+  yrot += turntable_step;
+
   rotation_matrix = glm::rotate(glm::mat4(1.0f), glm::radians(xrot), glm::vec3(1.0f,0.0f,0.0f));
   rotation_matrix = glm::rotate(rotation_matrix, glm::radians(yrot), glm::vec3(0.0f,1.0f,0.0f));
   rotation_matrix = glm::rotate(rotation_matrix, glm::radians(zrot), glm::vec3(0.0f,0.0f,1.0f));
@@ -221,20 +236,75 @@ void renderGL(void)
 
   view_matrix = projection_matrix*lookat_matrix;
 
-  glUniformMatrix4fv(viewMatrix, 1, GL_FALSE, glm::value_ptr(view_matrix));
+  // One upload of the camera serves every draw and every program this frame
+  frame_uniforms.view = lookat_matrix;
+  frame_uniforms.projection = projection_matrix;
+  frame_uniforms.view_projection = view_matrix;
+  frame_uniforms.camera_position = c_pos;
+  csX75::UpdateFrameUniformsGL(frame_ubo, frame_uniforms);
 
- // Draw the sphere
+ // Draw the sphere, only the model matrix is per object
   modelview_matrix = view_matrix*model_matrix;
-  glUniformMatrix4fv(uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(modelview_matrix));
+  shaderProgram->set(uModelMatrix, model_matrix);
   normal_matrix = glm::transpose (glm::inverse(glm::mat3(modelview_matrix)));
-  glUniformMatrix3fv(normalMatrix, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+  shaderProgram->set(normalMatrix, normal_matrix);
   //  glBindTexture(GL_TEXTURE_2D, tex);
   glBindVertexArray (vao[0]);
   glDrawArrays(GL_TRIANGLES, 0, num_vertices);
 }
 
+//! Headless frame - render, and queue the frame if it is being recorded or streamed
+void renderRecordGL(void)
+{
+  renderGL();
+  csX75::record_fb(NULL);
+  csX75::poll_fb_async();
+}
+
+//Print how many uniform uploads the program skipped, when run with --stats
+void printStats(void)
+{
+  std::cout<<"Uniform uploads: "<<shaderProgram->uploads<<", skipped as unchanged: "
+	   <<shaderProgram->skipped<<std::endl;
+}
+
 int main(int argc, char** argv)
 {
+  //! --record writes every frame to frame_%06d.png, X toggles recording in a window,
+  //! --stream PATH pipes every frame as raw PPM or Y4M video
+  bool record = csX75::parse_record_args(argc, argv);
+
+  bool headless = csX75::parse_headless_args(argc, argv);
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--anisotropy") == 0 && i + 1 < argc)
+	max_anisotropy = atof(argv[++i]);
+      else if (strcmp(argv[i], "--stats") == 0)
+	show_stats = true;
+    }
+
+  //! Render offscreen without a window when asked to (--headless or CSX75_HEADLESS=1)
+  if (headless)
+    {
+      if (!csX75::initHeadlessGL(512, 512))
+	return -1;
+      csX75::initGL();
+      initBuffersGL();
+      if (record)
+	csX75::start_recording(NULL);
+      csX75::runHeadlessGL(renderRecordGL);
+      csX75::stop_recording();
+      csX75::close_fb_stream();
+      //There is no Z key to press, so always keep the last frame
+      csX75::save_fb_toimage(NULL);
+      csX75::close_frame_writer();
+      if (show_stats)
+	printStats();
+      delete shaderProgram;
+      csX75::terminateHeadlessGL();
+      return 0;
+    }
+
   //! The pointer to the GLFW window
   GLFWwindow* window;
 
@@ -283,6 +353,8 @@ int main(int argc, char** argv)
   //Initialize GL state
   csX75::initGL();
   initBuffersGL();
+  if (record)
+    csX75::start_recording(window);
 
   // Loop until the user closes the window
   while (glfwWindowShouldClose(window) == 0)
@@ -293,9 +365,13 @@ int main(int argc, char** argv)
 
       if (save_frame) 
       {
-        csX75::save_fb_toimage(window); 
+        csX75::save_fb_toimage_async(window); 
         save_frame=!save_frame;
       }
+      // Queue this frame too if it is being recorded or streamed
+      csX75::record_fb(window);
+      // Write out captures that the GPU has finished, never waits
+      csX75::poll_fb_async();
 
       // Swap front and back buffers
       glfwSwapBuffers(window);
@@ -304,6 +380,13 @@ int main(int argc, char** argv)
       glfwPollEvents();
     }
   
+  csX75::stop_recording();
+  csX75::close_fb_stream();
+  csX75::flush_fb_async();
+  csX75::close_frame_writer();
+  if (show_stats)
+    printStats();
+  delete shaderProgram;
   glfwTerminate();
   return 0;
 }
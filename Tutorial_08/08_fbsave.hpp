@@ -37,6 +37,8 @@ bool solid=true;
 bool enable_perspective=false;
 //Enable FB save to image
 bool save_frame=false;
+//Degrees the cube turns about y every frame, for turntable recordings
+GLfloat turntable_step=0.0;
 
 //-------------------------------------------------------------------------
 
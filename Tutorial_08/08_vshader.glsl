@@ -5,12 +5,18 @@ in vec2 texCoord;
 in vec3 vNormal;
 
 out vec2 tex;
-uniform mat4 uModelViewMatrix;
+uniform mat4 uModelMatrix;
 uniform mat3 normalMatrix;
-uniform mat4 viewMatrix;
+layout(std140) uniform FrameUniforms
+{
+  mat4 viewMatrix;
+  mat4 projectionMatrix;
+  mat4 viewProjectionMatrix;
+  vec4 cameraPosition;
+};
 
 void main (void) 
 {
-  gl_Position = uModelViewMatrix * vPosition;
+  gl_Position = viewProjectionMatrix * uModelMatrix * vPosition;
   tex = texCoord;
 }
@@ -0,0 +1,30 @@
+#include "frame_uniforms.hpp"
+
+namespace csX75
+{
+  static_assert(sizeof(FrameUniforms) == 3 * 64 + 16, "FrameUniforms must match the std140 block");
+
+  GLuint CreateFrameUniformsGL(void)
+  {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, buffer);
+    return buffer;
+  }
+
+  void BindFrameUniformsGL(GLuint program)
+  {
+    //!GLSL 3.30 has no layout(binding = N), so the binding is set from here
+    GLuint block = glGetUniformBlockIndex(program, "FrameUniforms");
+    if (block != GL_INVALID_INDEX)
+      glUniformBlockBinding(program, block, FRAME_UNIFORMS_BINDING);
+  }
+
+  void UpdateFrameUniformsGL(GLuint buffer, const FrameUniforms &frame)
+  {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+  }
+};
@@ -0,0 +1,43 @@
+#ifndef _FRAME_UNIFORMS_HPP_
+#define _FRAME_UNIFORMS_HPP_
+
+#include <GL/glew.h>
+
+#include "glm/vec4.hpp"
+#include "glm/mat4x4.hpp"
+
+//! Uniform buffer binding point of the per-frame block, the same in every program
+#define FRAME_UNIFORMS_BINDING 0
+
+//! Camera data that is the same for every draw in a frame. Shaders declare it as
+//!
+//!   layout(std140) uniform FrameUniforms
+//!   {
+//!     mat4 viewMatrix;
+//!     mat4 projectionMatrix;
+//!     mat4 viewProjectionMatrix;
+//!     vec4 cameraPosition;
+//!   };
+//!
+//! glm matrices are 16 floats, column by column, which is already the std140
+//! layout of a mat4, so the struct is copied into the buffer as it is.
+struct FrameUniforms
+{
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 view_projection;
+  glm::vec4 camera_position;
+};
+
+namespace csX75
+{
+  //! Create the buffer and bind it to FRAME_UNIFORMS_BINDING, where it stays
+  GLuint CreateFrameUniformsGL(void);
+  //! Point a program's FrameUniforms block at FRAME_UNIFORMS_BINDING. Needed once
+  //! after every link, a program without the block is left alone.
+  void BindFrameUniformsGL(GLuint program);
+  //! Upload this frame's camera, once for all programs
+  void UpdateFrameUniformsGL(GLuint buffer, const FrameUniforms &frame);
+};
+
+#endif
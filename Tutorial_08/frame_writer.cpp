@@ -0,0 +1,156 @@
+#include "frame_writer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+namespace csX75
+{
+  FrameWriter::FrameWriter(int num_threads, int queue_size, DropPolicy a_policy)
+    : jobs(queue_size > 0 ? queue_size : 1),
+      free_jobs(jobs.size()),
+      pending_jobs(jobs.size()),
+      policy(a_policy),
+      stopping(false),
+      outstanding(0),
+      num_written(0),
+      num_dropped(0),
+      num_failed(0),
+      encode_usec(0)
+  {
+    for (std::size_t i = 0; i < jobs.size(); i++)
+      free_jobs.push(&jobs[i]);
+
+    if (num_threads <= 0)
+      num_threads = (int) std::thread::hardware_concurrency() - 1;
+    if (num_threads < 1)
+      num_threads = 1;
+
+    //!The flip flag is a global in stb, set it once before any encoder runs
+    stbi_flip_vertically_on_write(true);
+
+    for (int i = 0; i < num_threads; i++)
+      workers.push_back(std::thread(&FrameWriter::worker_loop, this, i));
+  }
+
+  FrameWriter::~FrameWriter()
+  {
+    finish();
+    stopping = true;
+    work_cv.notify_all();
+    for (std::size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+  }
+
+  FrameJob* FrameWriter::acquire()
+  {
+    FrameJob* job;
+    for (;;)
+      {
+	if (free_jobs.pop(job))
+	  return job;
+
+	if (policy == WRITER_DROP_NEWEST)
+	  {
+	    num_dropped++;
+	    return NULL;
+	  }
+	//!Steal the oldest frame back from the encoders before they start on it
+	if (policy == WRITER_DROP_OLDEST && pending_jobs.pop(job))
+	  {
+	    num_dropped++;
+	    outstanding--;
+	    return job;
+	  }
+
+	//!Back-pressure - every buffer is being encoded, wait for one to come back
+	std::unique_lock<std::mutex> lock(wait_mutex);
+	done_cv.wait_for(lock, std::chrono::milliseconds(1));
+      }
+  }
+
+  void FrameWriter::submit(FrameJob* job)
+  {
+    outstanding++;
+    //!Cannot fail, there are never more jobs than queue slots
+    pending_jobs.push(job);
+    work_cv.notify_one();
+  }
+
+  void FrameWriter::finish()
+  {
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    while (outstanding.load() > 0)
+      done_cv.wait_for(lock, std::chrono::milliseconds(1));
+  }
+
+  void FrameWriter::worker_loop(int id)
+  {
+    std::vector<float> hdr_scratch;
+    FrameJob* job;
+    for (;;)
+      {
+	if (pending_jobs.pop(job))
+	  {
+	    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	    if (encode(job, id, hdr_scratch))
+	      num_written++;
+	    else
+	      num_failed++;
+	    encode_usec += std::chrono::duration_cast<std::chrono::microseconds>
+	      (std::chrono::steady_clock::now() - start).count();
+
+	    free_jobs.push(job);
+	    outstanding--;
+	    done_cv.notify_all();
+	    continue;
+	  }
+
+	if (stopping.load())
+	  return;
+	//!The queue itself is lock free, the mutex only parks idle encoders
+	std::unique_lock<std::mutex> lock(wait_mutex);
+	work_cv.wait_for(lock, std::chrono::milliseconds(2));
+      }
+  }
+
+  bool FrameWriter::encode(FrameJob* job, int id, std::vector<float>& hdr_scratch)
+  {
+    //!Write to a private file and rename it, so a reader never sees half a frame
+    //!and two encoders writing the same name cannot interleave
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".part%d", id);
+    std::string partial = job->filename + suffix;
+
+    int num_channels = 4;
+    int ok = 0;
+    switch (job->format)
+      {
+      case IMAGE_JPG:
+	ok = stbi_write_jpg(partial.c_str(), job->width, job->height, num_channels, job->pixels.data(), job->quality);
+	break;
+      case IMAGE_PNG:
+	ok = stbi_write_png(partial.c_str(), job->width, job->height, num_channels, job->pixels.data(), num_channels * job->width);
+	break;
+      case IMAGE_TGA:
+	ok = stbi_write_tga(partial.c_str(), job->width, job->height, num_channels, job->pixels.data());
+	break;
+      case IMAGE_HDR:
+	hdr_scratch.resize(job->pixels.size());
+	for (std::size_t i = 0; i < job->pixels.size(); i++)
+	  hdr_scratch[i] = job->pixels[i] / 255.0f;
+	ok = stbi_write_hdr(partial.c_str(), job->width, job->height, num_channels, hdr_scratch.data());
+	break;
+      }
+
+    if (!ok || rename(partial.c_str(), job->filename.c_str()) != 0)
+      {
+	std::cerr<<"Could not write "<<job->filename<<std::endl;
+	remove(partial.c_str());
+	return false;
+      }
+    return true;
+  }
+};
@@ -0,0 +1,170 @@
+#ifndef _FRAME_WRITER_HPP_
+#define _FRAME_WRITER_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace csX75
+{
+  //! Image formats of the stb_image_write encoders
+  enum ImageFormat { IMAGE_JPG, IMAGE_PNG, IMAGE_TGA, IMAGE_HDR };
+
+  //! What happens to a new frame when every frame buffer is already queued
+  enum DropPolicy
+  {
+    WRITER_BLOCK,       //!< wait for an encoder to free a buffer (back-pressure)
+    WRITER_DROP_NEWEST, //!< skip the new frame
+    WRITER_DROP_OLDEST  //!< throw away the oldest frame that is not yet being encoded
+  };
+
+  //! One raw RGBA frame, bottom row first as glReadPixels returns it
+  struct FrameJob
+  {
+    std::vector<unsigned char> pixels;
+    int width, height;
+    ImageFormat format;
+    int quality;
+    std::string filename;
+  };
+
+  //! Bounded multi-producer multi-consumer queue without locks (D. Vyukov).
+  //! Every cell carries a sequence number telling whether it is free to write
+  //! or ready to read for the current lap, so push and pop are a single CAS.
+  template <typename T>
+  class BoundedQueue
+  {
+    struct Cell
+    {
+      std::atomic<std::size_t> sequence;
+      T data;
+    };
+
+    Cell* cells;
+    std::size_t mask;
+    std::atomic<std::size_t> enqueue_pos;
+    std::atomic<std::size_t> dequeue_pos;
+
+  public:
+    //! capacity is rounded up to a power of two
+    BoundedQueue(std::size_t capacity)
+    {
+      std::size_t size = 2;
+      while (size < capacity)
+	size *= 2;
+      cells = new Cell[size];
+      mask = size - 1;
+      for (std::size_t i = 0; i < size; i++)
+	cells[i].sequence.store(i, std::memory_order_relaxed);
+      enqueue_pos.store(0, std::memory_order_relaxed);
+      dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    ~BoundedQueue()
+    {
+      delete[] cells;
+    }
+
+    //! Returns false when the queue is full
+    bool push(const T& value)
+    {
+      std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+      for (;;)
+	{
+	  Cell* cell = &cells[pos & mask];
+	  std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+	  std::ptrdiff_t diff = (std::ptrdiff_t) seq - (std::ptrdiff_t) pos;
+	  if (diff == 0)
+	    {
+	      if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+		{
+		  cell->data = value;
+		  cell->sequence.store(pos + 1, std::memory_order_release);
+		  return true;
+		}
+	    }
+	  else if (diff < 0)
+	    return false;
+	  else
+	    pos = enqueue_pos.load(std::memory_order_relaxed);
+	}
+    }
+
+    //! Returns false when the queue is empty
+    bool pop(T& value)
+    {
+      std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+      for (;;)
+	{
+	  Cell* cell = &cells[pos & mask];
+	  std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+	  std::ptrdiff_t diff = (std::ptrdiff_t) seq - (std::ptrdiff_t) (pos + 1);
+	  if (diff == 0)
+	    {
+	      if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+		{
+		  value = cell->data;
+		  cell->sequence.store(pos + mask + 1, std::memory_order_release);
+		  return true;
+		}
+	    }
+	  else if (diff < 0)
+	    return false;
+	  else
+	    pos = dequeue_pos.load(std::memory_order_relaxed);
+	}
+    }
+  };
+
+  //! A pool of encoder threads that write captured frames to image files, so
+  //! the render thread only pays for a memcpy. Frame buffers are preallocated
+  //! and recycled through two queues: free -> (acquire, fill, submit) ->
+  //! pending -> (encoder) -> free.
+  class FrameWriter
+  {
+    std::vector<FrameJob> jobs;
+    BoundedQueue<FrameJob*> free_jobs;
+    BoundedQueue<FrameJob*> pending_jobs;
+    DropPolicy policy;
+
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping;
+    std::atomic<int> outstanding;
+    std::mutex wait_mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+
+    std::atomic<unsigned long> num_written;
+    std::atomic<unsigned long> num_dropped;
+    std::atomic<unsigned long> num_failed;
+    std::atomic<long long> encode_usec;
+
+    void worker_loop(int id);
+    bool encode(FrameJob* job, int id, std::vector<float>& hdr_scratch);
+
+  public:
+    //! num_threads <= 0 picks one less than the number of cores
+    FrameWriter(int num_threads, int queue_size, DropPolicy policy);
+    ~FrameWriter();
+
+    //! An empty frame to fill and submit, or NULL if this frame is dropped
+    FrameJob* acquire();
+    //! Queue a filled frame for encoding
+    void submit(FrameJob* job);
+    //! Wait until every submitted frame has been written
+    void finish();
+
+    unsigned long frames_written() const { return num_written.load(); }
+    unsigned long frames_dropped() const { return num_dropped.load(); }
+    unsigned long frames_failed() const { return num_failed.load(); }
+    //! Encoder time summed over all threads
+    double encode_seconds() const { return encode_usec.load() * 1e-6; }
+    int num_threads() const { return (int) workers.size(); }
+  };
+};
+
+#endif
@@ -1,12 +1,21 @@
 #include "gl_framework.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <string>
 #include <vector>
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#include <unistd.h>
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
 extern GLfloat xrot,yrot,zrot,c_xrot,c_yrot,c_zrot;
 extern bool enable_perspective;
 extern bool save_frame;
+extern GLfloat turntable_step;
 
 namespace csX75
 {
@@ -68,12 +77,196 @@ namespace csX75
       c_zrot += 1.0;  
     else if (key == GLFW_KEY_Z)
       save_frame = true;
+    else if (key == GLFW_KEY_X && action == GLFW_PRESS)
+      {
+	if (is_recording())
+	  stop_recording();
+	else
+	  start_recording(window);
+      }
+  }
+
+  //! Encoder pool shared by every capture path, created on first use
+  static FrameWriter* frame_writer = NULL;
+
+  void init_frame_writer(int num_threads, int queue_size, DropPolicy policy)
+  {
+    close_frame_writer();
+    frame_writer = new FrameWriter(num_threads, queue_size, policy);
+  }
+
+  void close_frame_writer(void)
+  {
+    //!Deleting the pool waits for the frames still in its queue
+    delete frame_writer;
+    frame_writer = NULL;
+  }
+
+  //! Copy one RGBA frame read back from GL (bottom row first) and queue it for
+  //! the encoder threads. Returns the number of frames queued, 0 if dropped.
+  static int write_fb_image(const char* pixels, int width, int height,
+			    const std::string& filename, ImageFormat format)
+  {
+    if (frame_writer == NULL)
+      init_frame_writer(0, 8, WRITER_BLOCK);
+
+    FrameJob* job = frame_writer->acquire();
+    if (job == NULL)
+      return 0;
+
+    GLsizei num_channels = 4;
+    job->pixels.resize(num_channels * width * height);
+    memcpy(job->pixels.data(), pixels, job->pixels.size());
+    job->width = width;
+    job->height = height;
+    job->format = format;
+    job->quality = 100;
+    job->filename = filename;
+    frame_writer->submit(job);
+    return 1;
+  }
+
+  //! Raw video stream sink - one file, FIFO or stdout opened once, every frame
+  //! appended to it, so an external encoder reads frames with no files in between
+  static FILE* fb_stream = NULL;
+  static StreamFormat fb_stream_format = STREAM_PPM;
+  static int fb_stream_fps = 30;
+  static int fb_stream_width = 0, fb_stream_height = 0;
+  static std::vector<unsigned char> fb_stream_row;
+  static std::vector<char> fb_stream_buffer;
+
+  bool open_fb_stream(const char* path, StreamFormat format, int fps)
+  {
+    close_fb_stream();
+    if (strcmp(path, "-") == 0)
+      {
+	//!Keep the real stdout for frames and send everything printed from now on to stderr
+	std::cout.flush();
+	fflush(stdout);
+	int fd = dup(STDOUT_FILENO);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+	fb_stream = fdopen(fd, "wb");
+      }
+    else
+      fb_stream = fopen(path, "wb");
+    if (fb_stream == NULL)
+      {
+	std::cerr<<"Cannot open stream: "<<path<<std::endl;
+	return false;
+      }
+
+    //!A reader that goes away should end the stream, not kill the renderer
+    signal(SIGPIPE, SIG_IGN);
+    fb_stream_buffer.resize(1 << 20);
+    setvbuf(fb_stream, fb_stream_buffer.data(), _IOFBF, fb_stream_buffer.size());
+    fb_stream_format = format;
+    fb_stream_fps = fps > 0 ? fps : 30;
+    fb_stream_width = fb_stream_height = 0;
+    return true;
+  }
+
+  void close_fb_stream(void)
+  {
+    if (fb_stream == NULL)
+      return;
+    flush_fb_async();
+    fclose(fb_stream);
+    fb_stream = NULL;
+  }
+
+  bool is_streaming(void)
+  {
+    return fb_stream != NULL;
+  }
+
+  //! Append one RGBA frame (bottom row first) to the stream. Rows are written
+  //! last to first straight out of the mapped buffer, which flips the image
+  //! without copying it, and alpha is dropped on the way.
+  static int write_fb_stream(const unsigned char* pixels, int width, int height)
+  {
+    if (fb_stream == NULL)
+      return 0;
+
+    if (fb_stream_width == 0)
+      {
+	fb_stream_width = width;
+	fb_stream_height = height;
+	if (fb_stream_format == STREAM_Y4M)
+	  fprintf(fb_stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fb_stream_fps);
+      }
+    //!A Y4M stream cannot change size half way
+    if (width != fb_stream_width || height != fb_stream_height)
+      {
+	if (fb_stream_format == STREAM_Y4M)
+	  return 0;
+	fb_stream_width = width;
+	fb_stream_height = height;
+      }
+
+    size_t row_size = (fb_stream_format == STREAM_Y4M) ? width : 3 * width;
+    fb_stream_row.resize(row_size);
+    unsigned char* out = fb_stream_row.data();
+
+    if (fb_stream_format == STREAM_PPM)
+      {
+	fprintf(fb_stream, "P6\n%d %d\n255\n", width, height);
+	for (int y = height - 1; y >= 0; y--)
+	  {
+	    const unsigned char* in = pixels + 4 * width * y;
+	    for (int x = 0; x < width; x++)
+	      {
+		out[3 * x] = in[4 * x];
+		out[3 * x + 1] = in[4 * x + 1];
+		out[3 * x + 2] = in[4 * x + 2];
+	      }
+	    fwrite(out, 1, row_size, fb_stream);
+	  }
+      }
+    else
+      {
+	//!Planar 4:4:4 BT.601 studio range - Y plane, then Cb, then Cr
+	fputs("FRAME\n", fb_stream);
+	for (int plane = 0; plane < 3; plane++)
+	  for (int y = height - 1; y >= 0; y--)
+	    {
+	      const unsigned char* in = pixels + 4 * width * y;
+	      for (int x = 0; x < width; x++)
+		{
+		  int r = in[4 * x], g = in[4 * x + 1], b = in[4 * x + 2];
+		  if (plane == 0)
+		    out[x] = (unsigned char) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		  else if (plane == 1)
+		    out[x] = (unsigned char) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		  else
+		    out[x] = (unsigned char) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	      fwrite(out, 1, row_size, fb_stream);
+	    }
+      }
+
+    if (ferror(fb_stream))
+      {
+	std::cerr<<"Stream closed by the reader"<<std::endl;
+	fclose(fb_stream);
+	fb_stream = NULL;
+	return 0;
+      }
+    return 1;
+  }
+
+  //! Size of the framebuffer being captured, a NULL window means the headless offscreen framebuffer
+  static void get_capture_size(GLFWwindow* window, int* width, int* height)
+  {
+    if (window != NULL)
+      glfwGetFramebufferSize(window, width, height);
+    else
+      get_headless_size(width, height);
   }
 
   int save_fb_toimage(GLFWwindow* window)
   {
     int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    get_capture_size(window, &width, &height);
 
     GLsizei num_channels = 4;
     GLsizei ch_width = num_channels * width;
@@ -81,14 +274,401 @@ namespace csX75
 
     std::vector<char> buffer(bufferSize);
     glPixelStorei(GL_PACK_ALIGNMENT, 4);
-    glReadBuffer(GL_BACK);
+    glReadBuffer(window != NULL ? GL_BACK : GL_COLOR_ATTACHMENT0);
     glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
 
-    stbi_flip_vertically_on_write(true);
-    int num_bytes_written = stbi_write_jpg("saved_frame.jpg", width, height, num_channels, buffer.data(), 100);
+    return write_fb_image(buffer.data(), width, height, "saved_frame.jpg", IMAGE_JPG);
+  }
+
+  //! Ring of pixel pack buffers for asynchronous readback. glReadPixels into a
+  //! bound GL_PIXEL_PACK_BUFFER returns at once, and the copy is only mapped when
+  //! its fence has signalled, so frame N is read while N+1 and N+2 are rendering.
+  static GLuint capture_pbo[CAPTURE_RING_SIZE];
+  static GLsync capture_fence[CAPTURE_RING_SIZE];
+  static int capture_width = 0, capture_height = 0;
+  static int capture_head = 0, capture_count = 0;
+  //! Where each readback in the ring goes once it is mapped
+  static std::string capture_filename[CAPTURE_RING_SIZE];
+  static ImageFormat capture_format[CAPTURE_RING_SIZE];
+  static bool capture_to_stream[CAPTURE_RING_SIZE];
+
+  //! Map the oldest readback in flight, waiting for it if needed, and write it out
+  static int retire_oldest_capture(void)
+  {
+    int slot = (capture_head + CAPTURE_RING_SIZE - capture_count) % CAPTURE_RING_SIZE;
+    while (glClientWaitSync(capture_fence[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+      ;
+    glDeleteSync(capture_fence[slot]);
+    capture_count--;
 
-    return num_bytes_written;
+    int num_frames_queued = 0;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbo[slot]);
+    const char* pixels = (const char*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+							 4 * capture_width * capture_height, GL_MAP_READ_BIT);
+    if (pixels != NULL)
+      {
+	if (capture_to_stream[slot])
+	  num_frames_queued = write_fb_stream((const unsigned char*) pixels, capture_width, capture_height);
+	else
+	  num_frames_queued = write_fb_image(pixels, capture_width, capture_height,
+					     capture_filename[slot], capture_format[slot]);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return num_frames_queued;
+  }
+
+  //! Queue a readback of the framebuffer into the next buffer of the ring, for
+  //! an image file or, with to_stream, for the raw stream
+  static int read_fb_async(GLFWwindow* window, const std::string& filename, ImageFormat format,
+			   bool to_stream)
+  {
+    int width, height;
+    get_capture_size(window, &width, &height);
+
+    int num_frames_queued = 0;
+    //!(Re)size the ring on first use and whenever the framebuffer changes size
+    if (width != capture_width || height != capture_height)
+      {
+	num_frames_queued += flush_fb_async();
+	if (capture_width == 0)
+	  glGenBuffers(CAPTURE_RING_SIZE, capture_pbo);
+	capture_width = width;
+	capture_height = height;
+	for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+	  {
+	    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbo[i]);
+	    glBufferData(GL_PIXEL_PACK_BUFFER, 4 * width * height, NULL, GL_STREAM_READ);
+	  }
+      }
+
+    //!Ring is full - only now does the render thread wait, on a frame that is two frames old
+    if (capture_count == CAPTURE_RING_SIZE)
+      num_frames_queued += retire_oldest_capture();
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbo[capture_head]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadBuffer(window != NULL ? GL_BACK : GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, BUFFER_OFFSET(0));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    capture_fence[capture_head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture_filename[capture_head] = filename;
+    capture_format[capture_head] = format;
+    capture_to_stream[capture_head] = to_stream;
+    capture_head = (capture_head + 1) % CAPTURE_RING_SIZE;
+    capture_count++;
+    return num_frames_queued;
+  }
+
+  int save_fb_toimage_async(GLFWwindow* window)
+  {
+    return read_fb_async(window, "saved_frame.jpg", IMAGE_JPG, false);
+  }
+
+  int poll_fb_async(void)
+  {
+    int num_frames_queued = 0;
+    while (capture_count > 0)
+      {
+	int slot = (capture_head + CAPTURE_RING_SIZE - capture_count) % CAPTURE_RING_SIZE;
+	if (glClientWaitSync(capture_fence[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+	  break;
+	num_frames_queued += retire_oldest_capture();
+      }
+    return num_frames_queued;
+  }
 
+  int flush_fb_async(void)
+  {
+    int num_frames_queued = 0;
+    while (capture_count > 0)
+      num_frames_queued += retire_oldest_capture();
+    return num_frames_queued;
+  }
+
+  //! Frame sequence recording state
+  static bool recording = false;
+  static bool record_requested = false;
+  static int record_every = 1;
+  static ImageFormat record_format = IMAGE_PNG;
+  static int record_policy = -1;
+  static unsigned long record_rendered = 0, record_queued = 0;
+  static std::chrono::steady_clock::time_point record_start;
+
+  bool parse_record_args(int &argc, char** argv)
+  {
+    const char* stream_path = NULL;
+    StreamFormat stream_format = STREAM_PPM;
+    int stream_fps = 30;
+
+    int out = 1;
+    for (int i = 1; i < argc; i++)
+      {
+	if (strcmp(argv[i], "--record") == 0)
+	  record_requested = true;
+	else if (strcmp(argv[i], "--record-every") == 0 && i + 1 < argc)
+	  {
+	    record_requested = true;
+	    record_every = atoi(argv[++i]);
+	  }
+	else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+	  {
+	    i++;
+	    if (strcmp(argv[i], "jpg") == 0)
+	      record_format = IMAGE_JPG;
+	    else if (strcmp(argv[i], "tga") == 0)
+	      record_format = IMAGE_TGA;
+	    else if (strcmp(argv[i], "hdr") == 0)
+	      record_format = IMAGE_HDR;
+	    else
+	      record_format = IMAGE_PNG;
+	  }
+	else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+	  stream_path = argv[++i];
+	else if (strcmp(argv[i], "--stream-format") == 0 && i + 1 < argc)
+	  stream_format = (strcmp(argv[++i], "y4m") == 0) ? STREAM_Y4M : STREAM_PPM;
+	else if (strcmp(argv[i], "--stream-fps") == 0 && i + 1 < argc)
+	  stream_fps = atoi(argv[++i]);
+	else if (strcmp(argv[i], "--turntable") == 0 && i + 1 < argc)
+	  turntable_step = atof(argv[++i]);
+	else if (strcmp(argv[i], "--drop") == 0 && i + 1 < argc)
+	  {
+	    i++;
+	    if (strcmp(argv[i], "newest") == 0)
+	      record_policy = WRITER_DROP_NEWEST;
+	    else if (strcmp(argv[i], "oldest") == 0)
+	      record_policy = WRITER_DROP_OLDEST;
+	    else
+	      record_policy = WRITER_BLOCK;
+	  }
+	else
+	  argv[out++] = argv[i];
+      }
+    argc = out;
+
+    if (record_every < 1)
+      record_every = 1;
+    //!Opened here, before anything else gets the chance to print to stdout
+    if (stream_path != NULL)
+      open_fb_stream(stream_path, stream_format, stream_fps);
+    return record_requested;
+  }
+
+  void start_recording(GLFWwindow* window)
+  {
+    if (recording)
+      return;
+
+    //!A batch run wants every frame, an interactive one should never stall on the encoders
+    DropPolicy policy = (DropPolicy) record_policy;
+    if (record_policy < 0)
+      policy = (window == NULL) ? WRITER_BLOCK : WRITER_DROP_NEWEST;
+    flush_fb_async();
+    init_frame_writer(0, 16, policy);
+
+    recording = true;
+    record_rendered = record_queued = 0;
+    record_start = std::chrono::steady_clock::now();
+    std::cout<<"Recording every "<<record_every<<" frame(s)"<<std::endl;
+  }
+
+  void stop_recording(void)
+  {
+    if (!recording)
+      return;
+    recording = false;
+
+    //!Wait for the ring and the encoders, so the report covers every frame
+    flush_fb_async();
+    frame_writer->finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - record_start).count();
+
+    unsigned long written = frame_writer->frames_written();
+    unsigned long dropped = frame_writer->frames_dropped();
+    double encode_seconds = frame_writer->encode_seconds();
+    std::cout<<"Recorded "<<written<<" of "<<record_rendered<<" rendered frames in "<<seconds<<" s, "
+	     <<dropped<<" dropped, "<<frame_writer->frames_failed()<<" failed"<<std::endl;
+    if (seconds > 0.0 && encode_seconds > 0.0)
+      std::cout<<"Encode throughput "<<written / seconds<<" frames/s with "<<frame_writer->num_threads()
+	       <<" thread(s), "<<written / encode_seconds<<" frames/s per thread"<<std::endl;
+  }
+
+  bool is_recording(void)
+  {
+    return recording;
+  }
+
+  int record_fb(GLFWwindow* window)
+  {
+    int num_frames_queued = 0;
+    //!The raw stream takes every frame
+    if (fb_stream != NULL)
+      num_frames_queued += read_fb_async(window, "", record_format, true);
+
+    if (!recording)
+      return num_frames_queued;
+    if (record_rendered++ % record_every != 0)
+      return num_frames_queued;
+
+    static const char* extension[] = { "jpg", "png", "tga", "hdr" };
+    char filename[64];
+    snprintf(filename, sizeof(filename), "frame_%06lu.%s", record_queued++, extension[record_format]);
+    return num_frames_queued + read_fb_async(window, filename, record_format, false);
+  }
+
+  //! Offscreen rendering state, used when there is no display to open a window on
+  static EGLDisplay headless_display = EGL_NO_DISPLAY;
+  static EGLContext headless_context = EGL_NO_CONTEXT;
+  static GLuint headless_fbo = 0;
+  static GLuint headless_rbo[2];
+  static int headless_width = 0, headless_height = 0;
+  static int headless_frames = 1;
+
+  bool parse_headless_args(int &argc, char** argv)
+  {
+    bool headless = false;
+
+    //!The environment lets a batch script switch every binary over at once
+    const char* env = getenv("CSX75_HEADLESS");
+    if (env != NULL && *env != '\0' && strcmp(env, "0") != 0)
+      headless = true;
+    env = getenv("CSX75_FRAMES");
+    if (env != NULL)
+      headless_frames = atoi(env);
+
+    //!Remove our flags so that the tutorial still sees its own arguments at argv[1]
+    int out = 1;
+    for (int i = 1; i < argc; i++)
+      {
+	if (strcmp(argv[i], "--headless") == 0)
+	  headless = true;
+	else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+	  headless_frames = atoi(argv[++i]);
+	else
+	  argv[out++] = argv[i];
+      }
+    argc = out;
+
+    if (headless_frames < 1)
+      headless_frames = 1;
+    return headless;
+  }
+
+  bool initHeadlessGL(int width, int height)
+  {
+    //!Prefer the Mesa surfaceless platform, it needs neither X11 nor a DRM master
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL)
+      headless_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (headless_display == EGL_NO_DISPLAY)
+      headless_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (headless_display == EGL_NO_DISPLAY || !eglInitialize(headless_display, &major, &minor))
+      {
+	std::cerr<<"EGL Init Failed"<<std::endl;
+	return false;
+      }
+
+    const EGLint config_attribs[] = {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE
+    };
+    EGLConfig config;
+    EGLint num_configs = 0;
+    eglChooseConfig(headless_display, config_attribs, &config, 1, &num_configs);
+
+    //!Same context that the GLFW window asks for - OpenGL 3.3 core
+    const EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION, 3,
+      EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE
+    };
+    eglBindAPI(EGL_OPENGL_API);
+    headless_context = eglCreateContext(headless_display, num_configs > 0 ? config : NULL,
+					EGL_NO_CONTEXT, context_attribs);
+    if (headless_context == EGL_NO_CONTEXT ||
+	!eglMakeCurrent(headless_display, EGL_NO_SURFACE, EGL_NO_SURFACE, headless_context))
+      {
+	std::cerr<<"EGL Context Creation Failed : "<<std::hex<<eglGetError()<<std::dec<<std::endl;
+	eglTerminate(headless_display);
+	return false;
+      }
+
+    //Turn this on to get Shader based OpenGL
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    if (GLEW_OK != err)
+      {
+	//A GLX-only GLEW reports a missing X display here, the GL entry points are loaded regardless
+	std::cerr<<"GLEW Init Failed : "<<glewGetErrorString(err)<<std::endl;
+      }
+
+    //!There is no default framebuffer, so draw into a colour and depth renderbuffer pair
+    headless_width = width;
+    headless_height = height;
+    glGenFramebuffers(1, &headless_fbo);
+    glGenRenderbuffers(2, headless_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless_rbo[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless_rbo[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, headless_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless_rbo[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headless_rbo[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      {
+	std::cerr<<"Offscreen framebuffer is incomplete"<<std::endl;
+	terminateHeadlessGL();
+	return false;
+      }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glViewport(0, 0, width, height);
+
+    std::cout<<"Headless Renderer: "<<glGetString (GL_RENDERER)<<std::endl;
+    return true;
+  }
+
+  void runHeadlessGL(void (*render)(void))
+  {
+    //!No swap, no vsync - frames are only limited by how fast the GL can draw them
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < headless_frames; i++)
+      render();
+    glFinish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout<<"Rendered "<<headless_frames<<" frames in "<<seconds<<" s ("
+	     <<headless_frames / seconds<<" fps)"<<std::endl;
+  }
+
+  void terminateHeadlessGL(void)
+  {
+    if (headless_fbo != 0)
+      {
+	glDeleteFramebuffers(1, &headless_fbo);
+	glDeleteRenderbuffers(2, headless_rbo);
+	headless_fbo = 0;
+      }
+    if (headless_display != EGL_NO_DISPLAY)
+      {
+	eglMakeCurrent(headless_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (headless_context != EGL_NO_CONTEXT)
+	  eglDestroyContext(headless_display, headless_context);
+	eglTerminate(headless_display);
+      }
+    headless_context = EGL_NO_CONTEXT;
+    headless_display = EGL_NO_DISPLAY;
+  }
+
+  void get_headless_size(int* width, int* height)
+  {
+    *width = headless_width;
+    *height = headless_height;
   }
 };  
   
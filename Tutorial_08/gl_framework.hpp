@@ -6,11 +6,19 @@
 
 #include <iostream>
 
+#include "frame_writer.hpp"
+
 // Define a helpful macro for handling offsets into buffer objects
 #define BUFFER_OFFSET( offset )   ((GLvoid*) (offset))
 
+// Number of pixel pack buffers used for asynchronous framebuffer readback
+#define CAPTURE_RING_SIZE 3
+
 namespace csX75
 {
+  //! Raw video formats for the stream sink
+  enum StreamFormat { STREAM_PPM, STREAM_Y4M };
+
   //! Initialize GL State
   void initGL(void);
  
@@ -21,7 +29,48 @@ namespace csX75
   //!GLFW keyboard callback
   void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
+  //! Start the pool of threads that encodes saved frames to image files
+  void init_frame_writer(int num_threads, int queue_size, DropPolicy policy);
+  //! Wait for every queued frame to be written and stop the encoder threads
+  void close_frame_writer(void);
+
   int save_fb_toimage(GLFWwindow* window);
+  //! Queue a readback of the framebuffer without waiting for the GPU
+  int save_fb_toimage_async(GLFWwindow* window);
+  //! Write out every queued readback that the GPU has already finished
+  int poll_fb_async(void);
+  //! Wait for and write out every queued readback
+  int flush_fb_async(void);
+
+  //! Frame sequence options - strips --record, --record-every N, --format png|jpg|tga|hdr,
+  //! --drop block|newest|oldest, --turntable DEG, --stream PATH, --stream-format ppm|y4m
+  //! and --stream-fps N from argv
+  bool parse_record_args(int &argc, char** argv);
+  //! Start writing frame_%06d files, the X key toggles this
+  void start_recording(GLFWwindow* window);
+  //! Wait for the frames in flight and report dropped frames and encode throughput
+  void stop_recording(void);
+  bool is_recording(void);
+  //! Called once per rendered frame, queues every Nth frame while recording
+  //! and every frame while streaming
+  int record_fb(GLFWwindow* window);
+
+  //! Open a raw PPM or Y4M stream to a file or FIFO, "-" is stdout
+  bool open_fb_stream(const char* path, StreamFormat format, int fps);
+  //! Write out the frames still in flight and close the stream
+  void close_fb_stream(void);
+  bool is_streaming(void);
+
+  //! Headless mode - strips --headless and --frames N from argv, also honours CSX75_HEADLESS
+  bool parse_headless_args(int &argc, char** argv);
+  //! Create a windowless EGL context that renders into an offscreen framebuffer
+  bool initHeadlessGL(int width, int height);
+  //! Render the requested number of frames into the offscreen framebuffer
+  void runHeadlessGL(void (*render)(void));
+  //! Release the offscreen framebuffer and the EGL context
+  void terminateHeadlessGL(void);
+  //! Size of the offscreen framebuffer
+  void get_headless_size(int* width, int* height);
 };
 
 #endif
@@ -1,56 +1,370 @@
 #include "gl_framework.hpp"
-#include <fstream>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 #include "texture.hpp"
 
-GLuint LoadTexture( const char * filename, int width, int height )
+//BMP fields are little endian and not aligned, read them byte by byte
+static unsigned int read_u16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static unsigned int read_u32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+//Map a whole file read-only, NULL if it cannot be or is shorter than min_size
+static void* map_file( const char * filename, size_t min_size, size_t& file_size )
+{
+    int fd = open( filename, O_RDONLY );
+    if ( fd < 0 )
+      {
+	printf("Cannot open %s\n", filename);
+	return NULL;
+      }
+    struct stat st;
+    if ( fstat(fd, &st) != 0 || (size_t) st.st_size < min_size )
+      {
+	printf("Incorrect file %s\n", filename);
+	close( fd );
+	return NULL;
+      }
+
+    file_size = st.st_size;
+    void* mapping = mmap( NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd ); // the mapping keeps the file alive
+    if ( mapping == MAP_FAILED )
+      {
+	printf("Cannot map %s\n", filename);
+	return NULL;
+      }
+    return mapping;
+}
+
+bool MapBMP( const char * filename, BMPImage& image )
+{
+    image.mapping = NULL;
+    image.mapping_size = 0;
+
+    size_t file_size;
+    void* mapping = map_file( filename, 54, file_size );
+    if ( mapping == NULL )
+      return false;
+    const unsigned char* header = (const unsigned char*) mapping;
+
+    // Read  MetaData - file header (14 bytes) then at least a BITMAPINFOHEADER (40 bytes)
+    unsigned int pos = read_u32(header + 0x0A);
+    unsigned int info_size = read_u32(header + 0x0E);
+    int w = (int) read_u32(header + 0x12);
+    int h = (int) read_u32(header + 0x16);
+    unsigned int planes = read_u16(header + 0x1A);
+    unsigned int bpp = read_u16(header + 0x1C);
+    unsigned int compression = read_u32(header + 0x1E);
+
+    const char* error = NULL;
+    if ( header[0] != 'B' || header[1] != 'M' || info_size < 40 || planes != 1 )
+      error = "not a Windows BMP";
+    else if ( compression != 0 || (bpp != 24 && bpp != 32) )
+      error = "only uncompressed 24 and 32 bit BMPs are supported";
+    else if ( w <= 0 || h == 0 || w > 65536 || h > 65536 || h < -65536 )
+      error = "bad image size";
+    else if ( pos == 0 )
+      pos = 14 + info_size; //Just in case metadata is missing
+
+    int rows = h < 0 ? -h : h;
+    size_t stride = ((size_t) w * bpp + 31) / 32 * 4; // rows are padded to 4 bytes
+    if ( error == NULL && (pos > file_size || stride * rows > file_size - pos) )
+      error = "file is truncated";
+
+    if ( error != NULL )
+      {
+	printf("Incorrect BMP file %s: %s\n", filename, error);
+	munmap( mapping, file_size );
+	return false;
+      }
+
+    madvise( mapping, file_size, MADV_SEQUENTIAL );
+    image.mapping = mapping;
+    image.mapping_size = file_size;
+    image.pixels = header + pos;
+    image.width = w;
+    image.height = rows;
+    image.bytes_per_pixel = bpp / 8;
+    image.stride = (int) stride;
+    image.top_down = h < 0;
+    return true;
+}
+
+void UnmapBMP( BMPImage& image )
+{
+  if ( image.mapping != NULL )
+    munmap( image.mapping, image.mapping_size );
+  image.mapping = NULL;
+  image.pixels = NULL;
+}
+
+int MipLevels( int width, int height )
+{
+  int levels = 1;
+  for ( int size = width > height ? width : height; size > 1; size /= 2 )
+    levels++;
+  return levels;
+}
+
+//Halve an image with a 2x2 box filter. The source rows are src_stride apart,
+//bottom row first unless flip is set; the result is tightly packed. An odd last
+//row or column is dropped, as a 1 pixel wide source is only halved the other way.
+static void box_downsample( const unsigned char* src, int src_width, int src_height, size_t src_stride,
+			    bool flip, int bytes_per_pixel, unsigned char* dst, int dst_width, int dst_height )
+{
+  int dx = src_width > 1 ? 1 : 0;
+  int dy = src_height > 1 ? 1 : 0;
+  for ( int y = 0; y < dst_height; y++ )
+    {
+      int y0 = 2 * y * dy, y1 = y0 + dy;
+      if ( flip )
+	{
+	  y0 = src_height - 1 - y0;
+	  y1 = src_height - 1 - y1;
+	}
+      const unsigned char* row0 = src + (size_t) y0 * src_stride;
+      const unsigned char* row1 = src + (size_t) y1 * src_stride;
+      unsigned char* out = dst + (size_t) y * dst_width * bytes_per_pixel;
+      for ( int x = 0; x < dst_width; x++ )
+	{
+	  int x0 = 2 * x * dx * bytes_per_pixel, x1 = x0 + dx * bytes_per_pixel;
+	  for ( int c = 0; c < bytes_per_pixel; c++ )
+	    *out++ = (unsigned char) ((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+	}
+    }
+}
+
+void BuildBoxMipmaps( const BMPImage& image, std::vector<unsigned char>& chain )
+{
+  int levels = MipLevels( image.width, image.height );
+  size_t total = 0;
+  for ( int level = 1, w = image.width, h = image.height; level < levels; level++ )
+    {
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+      total += (size_t) w * h * image.bytes_per_pixel;
+    }
+  chain.resize( total );
+
+  // Each level is filtered from the one above it, level 1 straight from the mapping
+  const unsigned char* src = image.pixels;
+  size_t src_stride = image.stride;
+  bool flip = image.top_down;
+  int w = image.width, h = image.height;
+  unsigned char* dst = chain.data();
+  for ( int level = 1; level < levels; level++ )
+    {
+      int dst_w = w > 1 ? w / 2 : 1, dst_h = h > 1 ? h / 2 : 1;
+      box_downsample( src, w, h, src_stride, flip, image.bytes_per_pixel, dst, dst_w, dst_h );
+      src = dst;
+      src_stride = (size_t) dst_w * image.bytes_per_pixel;
+      flip = false;
+      w = dst_w;
+      h = dst_h;
+      dst += (size_t) w * h * image.bytes_per_pixel;
+    }
+}
+
+//Filtering, wrapping and anisotropy of the texture bound to GL_TEXTURE_2D
+static void set_sampling( int levels, float max_anisotropy )
+{
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+    if ( max_anisotropy > 1.0f && (GLEW_EXT_texture_filter_anisotropic || GLEW_ARB_texture_filter_anisotropic) )
+      {
+	GLfloat limit = 1.0f;
+	glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &limit );
+	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_anisotropy < limit ? max_anisotropy : limit );
+      }
+}
+
+GLuint CreateTexture( int width, int height, int bytes_per_pixel, TextureFilter filter, float max_anisotropy )
 {
     GLuint texture;
-    unsigned char header[54];// 54 Byte header of BMP
-    int pos;
-    unsigned int w,h;
-    unsigned int size; //w*h*3
-    unsigned char * data; // Data in RGB FORMAT
-    FILE * file;
-    
-    file = fopen( filename, "rb" ); 
-    if ( file == NULL ) return 0;  // if file is empty 
-    if (fread(header,1,54,file)!=54)
-      {
-	printf("Incorrect BMP file\n");
-	return 0;
+    int levels = filter == TEXTURE_LINEAR ? 1 : MipLevels( width, height );
+
+    glGenTextures( 1, &texture );
+    glBindTexture( GL_TEXTURE_2D, texture );
+    set_sampling( levels, max_anisotropy );
+
+    // Allocate every level up front. Immutable storage lets the driver skip its
+    // completeness checks on every draw; older drivers get the same levels one by one.
+    if ( GLEW_VERSION_4_2 || GLEW_ARB_texture_storage )
+      glTexStorage2D( GL_TEXTURE_2D, levels, bytes_per_pixel == 4 ? GL_RGBA8 : GL_RGB8, width, height );
+    else
+      {
+	for ( int level = 0, w = width, h = height; level < levels; level++ )
+	  {
+	    glTexImage2D( GL_TEXTURE_2D, level, bytes_per_pixel == 4 ? GL_RGBA : GL_RGB, w, h, 0,
+			  bytes_per_pixel == 4 ? GL_BGRA : GL_BGR, GL_UNSIGNED_BYTE, NULL );
+	    w = w > 1 ? w / 2 : 1;
+	    h = h > 1 ? h / 2 : 1;
+	  }
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1 );
       }
+    return texture;
+}
 
-    // Read  MetaData
-    pos = *(int*)&(header[0x0A]);
-    size = *(int*)&(header[0x22]);
-    w = *(int*)&(header[0x12]);
-    h = *(int*)&(header[0x16]);
+//KTX 1.1: a 64 byte header, key/value pairs, then every mip level as its size
+//followed by its blocks. Only single 2D images in a block compressed format
+//the driver knows are taken, and they are uploaded straight from the mapping.
+static GLuint load_ktx( const char * filename, int width, int height, TextureFilter filter, float max_anisotropy )
+{
+    static const unsigned char identifier[12] = {
+      0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+    };
+    size_t file_size;
+    void* mapping = map_file( filename, 64, file_size );
+    if ( mapping == NULL )
+      return 0;
+    const unsigned char* header = (const unsigned char*) mapping;
 
-    //Just in case metadata is missing
-    if(size == 0) 
-      size = w*h*3;
-    if(pos == 0)
-      pos = 54;
+    GLenum internal_format = read_u32(header + 28);
+    int w = (int) read_u32(header + 36);
+    int h = (int) read_u32(header + 40);
+    unsigned int levels = read_u32(header + 56);
+    size_t offset = 64 + (size_t) read_u32(header + 60);
 
-    data = new unsigned char [size];
+    const char* error = NULL;
+    if ( memcmp( header, identifier, sizeof(identifier) ) != 0 || read_u32(header + 12) != 0x04030201 )
+      error = "not a little endian KTX 1.1 file";
+    else if ( read_u32(header + 16) != 0 || read_u32(header + 44) != 0 || read_u32(header + 48) != 0 ||
+	      read_u32(header + 52) != 1 || w <= 0 || h <= 0 )
+      error = "only single compressed 2D textures are supported";
+    else if ( internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internal_format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT )
+      {
+	if ( !GLEW_EXT_texture_compression_s3tc )
+	  error = "the driver has no S3TC (BC1/BC3) support";
+      }
+    else if ( internal_format == GL_COMPRESSED_RGB8_ETC2 )
+      {
+	if ( !GLEW_VERSION_4_3 && !GLEW_ARB_ES3_compatibility )
+	  error = "the driver has no ETC2 support";
+      }
+    else
+      error = "unknown compressed format";
 
-    fread( data, size, 1, file ); // read the file
-    fclose( file );
-    //////////////////////////
+    // Find every level and check it lies inside the file
+    std::vector<const unsigned char*> level_data;
+    std::vector<GLsizei> level_size;
+    if ( levels == 0 )
+      levels = 1;
+    for ( unsigned int level = 0; error == NULL && level < levels; level++ )
+      {
+	if ( offset + 4 > file_size || read_u32(header + offset) > file_size - offset - 4 )
+	  error = "file is truncated";
+	else
+	  {
+	    level_size.push_back( read_u32(header + offset) );
+	    level_data.push_back( header + offset + 4 );
+	    offset += 4 + ((level_size.back() + 3) & ~3u);
+	  }
+      }
 
+    if ( error != NULL )
+      {
+	printf("Cannot load %s: %s\n", filename, error);
+	munmap( mapping, file_size );
+	return 0;
+      }
+    if ( (width != 0 && width != w) || (height != 0 && height != h) )
+      printf("%s is %dx%d, not %dx%d - using the size in the file\n", filename, w, h, width, height);
+    // Compressed textures cannot be mipmapped by GL, only the levels in the file exist
+    int used_levels = filter == TEXTURE_LINEAR ? 1 : (int) levels;
+
+    GLuint texture;
     glGenTextures( 1, &texture );
     glBindTexture( GL_TEXTURE_2D, texture );
-    
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
-   
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-    
-    free( data );
+    set_sampling( used_levels, max_anisotropy );
+    bool storage = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+    if ( storage )
+      glTexStorage2D( GL_TEXTURE_2D, used_levels, internal_format, w, h );
+    else
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, used_levels - 1 );
+
+    for ( int level = 0; level < used_levels; level++ )
+      {
+	if ( storage )
+	  glCompressedTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, w, h, internal_format,
+				     level_size[level], level_data[level] );
+	else
+	  glCompressedTexImage2D( GL_TEXTURE_2D, level, internal_format, w, h, 0,
+				  level_size[level], level_data[level] );
+	w = w > 1 ? w / 2 : 1;
+	h = h > 1 ? h / 2 : 1;
+      }
+
+    munmap( mapping, file_size );
+    return texture;
+}
+
+GLuint LoadTexture( const char * filename, int width, int height, TextureFilter filter, float max_anisotropy )
+{
+    BMPImage image;
+
+    size_t length = strlen( filename );
+    if ( length > 4 && strcmp( filename + length - 4, ".ktx" ) == 0 )
+      return load_ktx( filename, width, height, filter, max_anisotropy );
+    if ( !MapBMP( filename, image ) )
+      return 0;
+    if ( (width != 0 && width != image.width) || (height != 0 && height != image.height) )
+      printf("%s is %dx%d, not %dx%d - using the size in the file\n",
+	     filename, image.width, image.height, width, height);
+    //////////////////////////
+
+    GLuint texture = CreateTexture( image.width, image.height, image.bytes_per_pixel, filter, max_anisotropy );
+    GLenum format = image.bytes_per_pixel == 4 ? GL_BGRA : GL_BGR;
+
+    // Upload straight from the mapping. GL_UNPACK_ALIGNMENT 4 makes GL step over
+    // the BMP row padding, and both GL and BMP store the bottom row first.
+    GLint old_alignment;
+    glGetIntegerv( GL_UNPACK_ALIGNMENT, &old_alignment );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+    if ( !image.top_down )
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, image.pixels);
+    else
+      {
+	// A top-down BMP is flipped by uploading its rows in reverse order
+	for ( int y = 0; y < image.height; y++ )
+	  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, image.height - 1 - y, image.width, 1, format, GL_UNSIGNED_BYTE,
+			  image.pixels + (size_t) y * image.stride);
+      }
+
+    if ( filter == TEXTURE_MIPMAP )
+      glGenerateMipmap( GL_TEXTURE_2D );
+    else if ( filter == TEXTURE_MIPMAP_BOX )
+      {
+	std::vector<unsigned char> chain;
+	BuildBoxMipmaps( image, chain );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	const unsigned char* level_pixels = chain.data();
+	int levels = MipLevels( image.width, image.height );
+	for ( int level = 1, w = image.width, h = image.height; level < levels; level++ )
+	  {
+	    w = w > 1 ? w / 2 : 1;
+	    h = h > 1 ? h / 2 : 1;
+	    glTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, w, h, format, GL_UNSIGNED_BYTE, level_pixels );
+	    level_pixels += (size_t) w * h * image.bytes_per_pixel;
+	  }
+      }
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, old_alignment );
+    UnmapBMP( image );
     return texture;// return the texture id
 }
 void FreeTexture( GLuint texture )
@@ -1,5 +1,47 @@
 #ifndef _TEXTURE_HPP_
 #define _TEXTURE_HPP_
-GLuint LoadTexture( const char * filename, int width, int height );
+
+#include <cstddef>
+#include <vector>
+
+//! A BMP file mapped into memory. pixels points into the mapping at the
+//! first stored row, rows are stride bytes apart (padded to 4 bytes) and
+//! stored bottom row first unless top_down is set.
+struct BMPImage
+{
+  void* mapping;
+  size_t mapping_size;
+  const unsigned char* pixels;
+  int width, height;
+  int bytes_per_pixel;
+  int stride;
+  bool top_down;
+};
+
+//! Map and validate an uncompressed 24 or 32 bit BMP, false if it is not one
+bool MapBMP( const char * filename, BMPImage& image );
+void UnmapBMP( BMPImage& image );
+
+//! How LoadTexture filters a texture that is drawn smaller than it is
+enum TextureFilter
+{
+  TEXTURE_LINEAR,     //!< a single level, bilinear - aliases when minified
+  TEXTURE_MIPMAP,     //!< full mip chain built by the driver (glGenerateMipmap), trilinear
+  TEXTURE_MIPMAP_BOX  //!< full mip chain built here with a 2x2 box filter, identical on every driver
+};
+
+//! Number of levels in a full mip chain, down to 1x1
+int MipLevels( int width, int height );
+//! Levels 1 and down of a 2x2 box filtered mip chain, tightly packed one after the other
+void BuildBoxMipmaps( const BMPImage& image, std::vector<unsigned char>& chain );
+//! An empty texture, bound to GL_TEXTURE_2D, with storage for every level the filter needs
+GLuint CreateTexture( int width, int height, int bytes_per_pixel, TextureFilter filter, float max_anisotropy );
+
+//! Loads a BMP, or a block compressed KTX file (see bmp2ktx) when the name ends in .ktx.
+//! The texture size comes from the file, width and height are only checked against it.
+//! max_anisotropy > 1 turns on anisotropic filtering when the driver has it, clamped to its limit.
+//! A KTX file brings its own mip levels, TEXTURE_LINEAR uses only the first.
+GLuint LoadTexture( const char * filename, int width, int height,
+		    TextureFilter filter = TEXTURE_LINEAR, float max_anisotropy = 1.0f );
 void FreeTexture( GLuint texture );
-#endif 
+#endif